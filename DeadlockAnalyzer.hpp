@@ -0,0 +1,183 @@
+#pragma once
+#include "MahjongBitboard.hpp"
+
+using namespace std;
+
+// Detects positions that can no longer be cleared although legal pairs might still be left.
+// Tiles of a match class with two tiles left must go together, so do the pairs of a class with four
+// tiles left when only one way of pairing them is possible. Such forced pairs can be ordered: a pair
+// must go after the tiles lying on top of it and, when a partner blocks one side of a tile, after the
+// tiles on the other side. A pair that must go after itself, or a cycle among pairs, is a deadlock.
+// Only orderings that hold in every continuation are used, so a position reported as deadlocked is
+// always lost; the opposite is not true, the solver is still needed to prove a position winnable.
+class DeadlockAnalyzer {
+
+public:
+	DeadlockAnalyzer(const MahjongBitboard& board) {
+		// tiles above a tile, directly or through other tiles: a tile on top of a removed one has been removed too,
+		// so these tiles always have to go first
+		aboveMasks.resize(board.tileCount);
+		vector<char> done(board.tileCount, 0);
+		for (int idx = 0; idx < board.tileCount; idx++) computeAbove(board, idx, done);
+		// tiles met walking along the row of a tile, whatever is on the board
+		leftRows.resize(board.tileCount);
+		rightRows.resize(board.tileCount);
+		for (int idx = 0; idx < board.tileCount; idx++) {
+			leftRows[idx] = walkRow(board, idx, board.leftMasks);
+			rightRows[idx] = walkRow(board, idx, board.rightMasks);
+		}
+		relatedMasks.resize(board.tileCount);
+		for (int idx = 0; idx < board.tileCount; idx++) relatedMasks[idx] = aboveMasks[idx] | leftRows[idx] | rightRows[idx];
+		pairOf.resize(board.tileCount);
+	}
+
+	bool isDeadlocked(const MahjongBitboard& board) {
+		pairs.clear();
+		for (const TileSet& classMask : board.classMasks) {
+			TileSet left = board.present & classMask;
+			int count = left.count();
+			if (count == 2) {
+				int idx0 = left.first();
+				left.reset(idx0);
+				if (!addPair(board, idx0, left.first(), pairs)) return true;
+			}
+			else if (count == 4) {
+				int tiles[4];
+				bool related = false;
+				for (int i = 0; i < 4; i++) {
+					tiles[i] = left.first();
+					left.reset(tiles[i]);
+					related = related || relatedMasks[tiles[i]].intersects(board.present & classMask);
+				}
+				// tiles with no order between them can be paired any way, nothing is forced
+				if (!related) continue;
+				// the three ways to split four tiles in two pairs
+				const int pairings[3][4] = { { 0, 1, 2, 3 }, { 0, 2, 1, 3 }, { 0, 3, 1, 2 } };
+				int feasible = 0;
+				int lastFeasible = -1;
+				for (int p = 0; p < 3; p++) {
+					candidates.clear();
+					const int* pairing = pairings[p];
+					if (addPair(board, tiles[pairing[0]], tiles[pairing[1]], candidates) &&
+						addPair(board, tiles[pairing[2]], tiles[pairing[3]], candidates) &&
+						!(mustPrecede(candidates[0], candidates[1]) && mustPrecede(candidates[1], candidates[0]))) {
+						feasible++;
+						lastFeasible = p;
+					}
+				}
+				if (feasible == 0) return true;
+				if (feasible == 1) {
+					const int* pairing = pairings[lastFeasible];
+					addPair(board, tiles[pairing[0]], tiles[pairing[1]], pairs);
+					addPair(board, tiles[pairing[2]], tiles[pairing[3]], pairs);
+				}
+			}
+		}
+		return hasCycle();
+	}
+
+private:
+	// Pair of tiles to be removed together
+	struct ForcedPair {
+		TileSet tiles;
+		TileSet before;		// Tiles that have to be removed before the pair
+	};
+
+	vector<TileSet> aboveMasks;			// aboveMasks[i] contains the tiles lying over tile i, even indirectly
+	vector<TileSet> leftRows;			// leftRows[i] contains the tiles on the left of tile i, even indirectly
+	vector<TileSet> rightRows;			// rightRows[i] contains the tiles on the right of tile i, even indirectly
+	vector<TileSet> relatedMasks;		// Union of the three above, the only tiles that can ever go before tile i
+	vector<ForcedPair> pairs;			// Buffers reused between calls
+	vector<ForcedPair> candidates;
+	vector<char> visitState;
+	vector<int> pairOf;					// Forced pair of each tile in pairedTiles
+	TileSet pairedTiles;				// Tiles of all the forced pairs
+
+	const TileSet& computeAbove(const MahjongBitboard& board, int idx, vector<char>& done) {
+		if (!done[idx]) {
+			done[idx] = 1;
+			TileSet above = board.overMasks[idx];
+			board.overMasks[idx].forEach([&](int overIdx) {
+				above = above | computeAbove(board, overIdx, done);
+			});
+			aboveMasks[idx] = above;
+		}
+		return aboveMasks[idx];
+	}
+
+	TileSet walkRow(const MahjongBitboard& board, int idx, const vector<TileSet>& sideMasks) {
+		TileSet result = sideMasks[idx];
+		sideMasks[idx].forEach([&](int sideIdx) {
+			result = result | walkRow(board, sideIdx, sideMasks);
+		});
+		return result;
+	}
+
+	// adds the pair to the list, returns false if the pair can never be removed
+	bool addPair(const MahjongBitboard& board, int idx0, int idx1, vector<ForcedPair>& list) {
+		ForcedPair pair;
+		pair.tiles.set(idx0);
+		pair.tiles.set(idx1);
+		pair.before = (mustGoBefore(board, idx0, idx1) | mustGoBefore(board, idx1, idx0)) & board.present;
+		if (pair.before.intersects(pair.tiles)) return false;
+		list.push_back(pair);
+		return true;
+	}
+
+	// tiles to be removed before a tile that will be removed together with the given partner
+	TileSet mustGoBefore(const MahjongBitboard& board, int idx, int partner) {
+		TileSet result = aboveMasks[idx];
+		// while the partner is on one side, even through a row of tiles stuck between the two,
+		// that side stays blocked: the other side must be cleared
+		// most partners are not even in the same row, which is checked first
+		bool partnerLeft = leftRows[idx].test(partner) && reaches(board, idx, partner, board.leftMasks);
+		bool partnerRight = rightRows[idx].test(partner) && reaches(board, idx, partner, board.rightMasks);
+		if (partnerLeft) result = result | board.rightMasks[idx];
+		if (partnerRight) result = result | board.leftMasks[idx];
+		return result;
+	}
+
+	// returns true if target is met walking from idx in one direction through tiles on the board
+	bool reaches(const MahjongBitboard& board, int idx, int target, const vector<TileSet>& sideMasks) {
+		TileSet side = sideMasks[idx] & board.present;
+		if (side.test(target)) return true;
+		bool found = false;
+		side.forEach([&](int sideIdx) {
+			found = found || reaches(board, sideIdx, target, sideMasks);
+		});
+		return found;
+	}
+
+	bool mustPrecede(const ForcedPair& first, const ForcedPair& second) {
+		return second.before.intersects(first.tiles);
+	}
+
+	// looks for a cycle in the order between forced pairs, with a depth-first search
+	bool hasCycle() {
+		pairedTiles = TileSet();
+		for (int p = 0; p < (int)pairs.size(); p++) {
+			pairs[p].tiles.forEach([&](int idx) { pairOf[idx] = p; });
+			pairedTiles = pairedTiles | pairs[p].tiles;
+		}
+		visitState.assign(pairs.size(), 0);
+		for (int p = 0; p < (int)pairs.size(); p++) {
+			if (visitState[p] == 0 && visit(p)) return true;
+		}
+		return false;
+	}
+
+	// 0 not visited, 1 on the current path, 2 done
+	bool visit(int p) {
+		visitState[p] = 1;
+		// pairs to be removed before this one
+		TileSet earlier = pairs[p].before & pairedTiles;
+		while (earlier.any()) {
+			int q = pairOf[earlier.first()];
+			earlier = earlier - pairs[q].tiles;
+			if (visitState[q] == 1) return true;
+			if (visitState[q] == 0 && visit(q)) return true;
+		}
+		visitState[p] = 2;
+		return false;
+	}
+};
@@ -0,0 +1,236 @@
+#pragma once
+#include "DealRater.hpp"
+#include "MappedFile.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+using namespace std;
+
+// Deal prepared in advance, ready to be played
+struct PooledDeal {
+	uint64_t seed = 0;
+	uint64_t fingerprint = 0;		// Same for deals putting the same match classes on the same tiles
+	double difficulty = 0.0;		// From 0 (easy) to 1 (hard)
+	vector<uint16_t> suits;			// Suit of every tile
+};
+
+// Queue of deals generated and checked ahead of time by a worker thread, so that starting a game costs
+// no more than copying the suits of a deal. The worker deals new games, drops the ones already in the
+// pool or played and the ones the solver proves lost, rates the others and appends them until the pool
+// is full. Shuffled deals are also dropped when the solver runs out of nodes before finding a win, so
+// that every deal of the pool is known to be winnable; solvable deals are winnable by construction.
+// The queue and the fingerprints of the deals played are saved to a file after every change and loaded
+// back by the worker on start, so the deals prepared during a session are played in the next one and no
+// deal comes back in a later session.
+// File layout: a header, then for every deal its seed, fingerprint, difficulty and the suit of every tile
+// on 16 bits, then the fingerprints of all the deals seen, in the byte order of the machine (a local
+// cache, like the snapshots).
+class DealPool {
+
+public:
+	DealPool(shared_ptr<const MahjongLayout> layout, DealMode mode, const string& path, int capacity = 8) {
+		this->layout = layout;
+		this->mode = mode;
+		this->path = path;
+		this->capacity = capacity;
+		worker = thread([this] { workerLoop(); });
+	}
+
+	~DealPool() {
+		{
+			lock_guard<mutex> lock(poolMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		worker.join();
+	}
+
+	DealPool(const DealPool&) = delete;
+	DealPool& operator=(const DealPool&) = delete;
+
+	// deals the next game of the pool, returns false if the pool is empty: the caller then deals inline
+	bool pop(MahjongGame& game, double& difficulty) {
+		PooledDeal deal;
+		{
+			lock_guard<mutex> lock(poolMutex);
+			if (deals.empty()) return false;
+			deal = move(deals.front());
+			deals.pop_front();
+			dirty = true;
+		}
+		wake.notify_one();
+		game.restoreBoard([&](int idx) { return (int)deal.suits[idx]; }, [](int) { return false; });
+		game.seed = deal.seed;
+		game.dealMode = mode;
+		difficulty = deal.difficulty;
+		return true;
+	}
+
+	// records a deal played without going through the pool, so that the worker never prepares it again
+	void markPlayed(const MahjongGame& game) {
+		{
+			lock_guard<mutex> lock(poolMutex);
+			if (!seen.insert(fingerprint(game)).second) return;
+			dirty = true;
+		}
+		wake.notify_one();
+	}
+
+	int size() {
+		lock_guard<mutex> lock(poolMutex);
+		return (int)deals.size();
+	}
+
+	// match classes renumbered in order of first appearance, so the numbering of the suit vectors does not matter
+	static uint64_t fingerprint(const MahjongGame& game) {
+		vector<int> labels(game.suitVectors.size(), -1);
+		int nextLabel = 0;
+		// FNV-1a over the labels of the tiles
+		uint64_t key = 0xcbf29ce484222325ULL;
+		for (const Tile& tile : game.tiles) {
+			int& label = labels[tile.getSuitVectorIndex()];
+			if (label < 0) label = nextLabel++;
+			key = (key ^ (uint64_t)label) * 0x100000001b3ULL;
+		}
+		return key;
+	}
+
+private:
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t tileCount;
+		uint32_t dealMode;
+		uint32_t dealCount;
+		uint32_t seenCount;
+	};
+
+	static constexpr char MAGIC[4] = { 'M', 'J', 'D', 'P' };
+	static const uint32_t VERSION = 2;
+
+	shared_ptr<const MahjongLayout> layout;
+	DealMode mode;
+	string path;
+	int capacity;
+	thread worker;
+	mutex poolMutex;					// Protects the fields below
+	condition_variable wake;
+	deque<PooledDeal> deals;
+	unordered_set<uint64_t> seen;		// Fingerprints of the deals in the pool or already played
+	bool dirty = false;					// True when the file is behind the queue
+	atomic<bool> stopping{ false };
+
+	void workerLoop() {
+		MahjongGame game = MahjongGame(layout, mode);
+		// a quick rating: the pool must refill between two games
+		DealRater rater(20000);
+		rater.setStopCondition([this] { return stopping.load(); });
+		load(game);
+		while (true) {
+			bool full;
+			{
+				unique_lock<mutex> lock(poolMutex);
+				wake.wait(lock, [this] { return stopping || dirty || (int)deals.size() < capacity; });
+				if (stopping) break;
+				full = (int)deals.size() >= capacity;
+			}
+			save();
+			if (full) continue;
+
+			game.newGame(mode);
+			uint64_t key = fingerprint(game);
+			{
+				lock_guard<mutex> lock(poolMutex);
+				if (seen.count(key)) continue;
+			}
+			DealRating rating = rater.rate(game);
+			if (stopping) break;
+			if (rating.result == SOLVER_UNSOLVABLE || (mode == DEAL_RANDOM && rating.result != SOLVER_SOLVABLE)) continue;
+			PooledDeal deal;
+			deal.seed = game.seed;
+			deal.fingerprint = key;
+			// half how often random play gets stuck, half the share of first pairs not known to win
+			double losingStarts = rating.firstMoves > 0 ? 1.0 - (double)rating.winningMoves / rating.firstMoves : 1.0;
+			deal.difficulty = 0.5 * rating.deadEndRate + 0.5 * losingStarts;
+			for (const Tile& tile : game.tiles) deal.suits.push_back((uint16_t)tile.suitIdx);
+			lock_guard<mutex> lock(poolMutex);
+			seen.insert(key);
+			deals.push_back(move(deal));
+			dirty = true;
+		}
+		save();
+	}
+
+	// reads the deals saved by a previous session, each one is dealt again from its seed to check it
+	void load(MahjongGame& game) {
+		ifstream in(path, ios::binary);
+		if (!in) return;
+		vector<uint8_t> bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		FileHeader header;
+		int tileCount = layout->tileCount();
+		size_t recordSize = 2 * sizeof(uint64_t) + sizeof(double) + 2 * (size_t)tileCount;
+		if (bytes.size() < sizeof(FileHeader)) return;
+		memcpy(&header, bytes.data(), sizeof(FileHeader));
+		if (memcmp(header.magic, MAGIC, 4) != 0 || header.version != VERSION || (int)header.tileCount != tileCount || header.dealMode != mode) return;
+		if (bytes.size() != sizeof(FileHeader) + header.dealCount * recordSize + header.seenCount * sizeof(uint64_t)) return;
+		const uint8_t* record = bytes.data() + sizeof(FileHeader);
+		for (uint32_t i = 0; i < header.dealCount && !stopping; i++, record += recordSize) {
+			PooledDeal deal;
+			memcpy(&deal.seed, record, sizeof(uint64_t));
+			memcpy(&deal.fingerprint, record + sizeof(uint64_t), sizeof(uint64_t));
+			memcpy(&deal.difficulty, record + 2 * sizeof(uint64_t), sizeof(double));
+			deal.suits.resize(tileCount);
+			memcpy(deal.suits.data(), record + 2 * sizeof(uint64_t) + sizeof(double), 2 * (size_t)tileCount);
+			// a deal from another version of the layout or of the dealer would not match its seed anymore
+			game.newGame(mode, deal.seed);
+			bool matches = true;
+			for (const Tile& tile : game.tiles) matches = matches && tile.suitIdx == deal.suits[tile.tileIdx];
+			if (!matches) continue;
+			lock_guard<mutex> lock(poolMutex);
+			if ((int)deals.size() >= capacity || seen.count(deal.fingerprint)) continue;
+			seen.insert(deal.fingerprint);
+			deals.push_back(move(deal));
+		}
+		// added after the deals, which would otherwise be taken for played ones
+		record = bytes.data() + sizeof(FileHeader) + header.dealCount * recordSize;
+		lock_guard<mutex> lock(poolMutex);
+		for (uint32_t i = 0; i < header.seenCount; i++, record += sizeof(uint64_t)) {
+			uint64_t key;
+			memcpy(&key, record, sizeof(uint64_t));
+			seen.insert(key);
+		}
+	}
+
+	void save() {
+		vector<uint8_t> bytes;
+		{
+			lock_guard<mutex> lock(poolMutex);
+			if (!dirty) return;
+			dirty = false;
+			int tileCount = layout->tileCount();
+			FileHeader header = {};
+			memcpy(header.magic, MAGIC, 4);
+			header.version = VERSION;
+			header.tileCount = tileCount;
+			header.dealMode = mode;
+			header.dealCount = (uint32_t)deals.size();
+			header.seenCount = (uint32_t)seen.size();
+			bytes.resize(sizeof(FileHeader));
+			memcpy(bytes.data(), &header, sizeof(FileHeader));
+			for (const PooledDeal& deal : deals) {
+				const uint8_t* fields[3] = { (const uint8_t*)&deal.seed, (const uint8_t*)&deal.fingerprint, (const uint8_t*)&deal.difficulty };
+				for (const uint8_t* field : fields) bytes.insert(bytes.end(), field, field + 8);
+				const uint8_t* suits = (const uint8_t*)deal.suits.data();
+				bytes.insert(bytes.end(), suits, suits + 2 * (size_t)tileCount);
+			}
+			for (uint64_t key : seen) bytes.insert(bytes.end(), (const uint8_t*)&key, (const uint8_t*)&key + sizeof(uint64_t));
+		}
+		// the pool still works without its file, the deals are only lost at exit
+		MappedFile::writeAtomically(bytes, path);
+	}
+};
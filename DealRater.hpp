@@ -0,0 +1,98 @@
+#pragma once
+#include "MahjongSolver.hpp"
+
+using namespace std;
+
+// Difficulty figures of one deal
+struct DealRating {
+	uint64_t seed = 0;
+	SolverResult result = SOLVER_UNKNOWN;	// Whether the deal can be won, within the node budget
+	long long solverNodes = 0;				// Positions the solver expanded to decide the deal
+	int firstMoves = 0;						// Legal pairs at the start
+	int winningMoves = 0;					// First pairs from which the deal can still be won
+	int unknownMoves = 0;					// First pairs the solver could not decide within its budget
+	double branchingFactor = 0.0;			// Average number of legal pairs met during random playouts
+	double deadEndRate = 0.0;				// Fraction of random playouts getting stuck before clearing the board
+};
+
+// Rates how hard a deal is: the solver decides the deal and every first pair (the winning lines),
+// random playouts measure how many choices the player gets and how often random play gets stuck.
+// Results only depend on the seed of the deal, so a batch can be split among threads in any way,
+// each thread owning its own rater.
+class DealRater {
+
+public:
+	DealRater(long long nodeLimit = 100000, int playouts = 32, size_t tableBytes = 16 << 20) : solver(tableBytes, nodeLimit) {
+		this->playouts = playouts;
+	}
+
+	// polled by the solver, returning true cuts the rating short, results are then incomplete
+	void setStopCondition(function<bool()> condition) {
+		solver.stopCondition = condition;
+	}
+
+	DealRating rate(const MahjongGame& game) {
+		MahjongBitboard board(game);
+		DealRating rating;
+		rating.seed = game.seed;
+		rating.result = solver.solve(board);
+		rating.solverNodes = solver.nodes;
+		// an empty board is solved with no move at all
+		pair<int, int> knownWin = rating.result == SOLVER_SOLVABLE && !solver.solution.empty() ? solver.solution[0] : pair<int, int>(-1, -1);
+
+		// winning lines: a deal proven lost has none, the first pair of a solution is known to win
+		board.forEachLegalPair([&](int idx0, int idx1) {
+			rating.firstMoves++;
+			if (rating.result == SOLVER_UNSOLVABLE) return false;
+			if (idx0 == knownWin.first && idx1 == knownWin.second) {
+				rating.winningMoves++;
+				return false;
+			}
+			board.present.reset(idx0);
+			board.present.reset(idx1);
+			// positions proven lost while solving the deal stay lost: the table is kept between the solves
+			SolverResult result = solver.solve(board, true);
+			board.restoreTiles(idx0, idx1);
+			if (result == SOLVER_SOLVABLE) rating.winningMoves++;
+			else if (result == SOLVER_UNKNOWN) rating.unknownMoves++;
+			return false;
+		});
+
+		// random playouts, seeded by the deal
+		rng.seed(~game.seed);
+		TileSet start = board.present;
+		long long positions = 0;
+		long long branches = 0;
+		int deadEnds = 0;
+		for (int i = 0; i < playouts; i++) {
+			board.present = start;
+			if (!playout(board, positions, branches)) deadEnds++;
+		}
+		rating.branchingFactor = positions > 0 ? (double)branches / positions : 0.0;
+		rating.deadEndRate = playouts > 0 ? (double)deadEnds / playouts : 0.0;
+		return rating;
+	}
+
+private:
+	MahjongSolver solver;
+	int playouts;
+	mt19937_64 rng;
+	vector<pair<int, int>> pairs;		// Legal pairs of the current step, reused between steps
+
+	// plays random pairs until the board is cleared or stuck, returns true if cleared
+	bool playout(MahjongBitboard& board, long long& positions, long long& branches) {
+		while (true) {
+			pairs.clear();
+			board.forEachLegalPair([&](int idx0, int idx1) {
+				pairs.push_back({ idx0, idx1 });
+				return false;
+			});
+			if (pairs.empty()) return board.isWon();
+			positions++;
+			branches += pairs.size();
+			pair<int, int> chosen = pairs[rng() % pairs.size()];
+			board.present.reset(chosen.first);
+			board.present.reset(chosen.second);
+		}
+	}
+};
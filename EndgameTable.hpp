@@ -0,0 +1,355 @@
+#pragma once
+#include "MahjongBitboard.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <unordered_set>
+
+using namespace std;
+
+// Header of an endgame table file, followed by the displacements and the slots of the perfect hash.
+// Offsets are in bytes from the beginning of the file, all the values are little endian.
+struct EndgameFileHeader {
+	char magic[4];					// "MJEG"
+	uint32_t version;
+	uint64_t fileSize;
+	uint64_t dealKey;				// Fingerprint of the layout and of the match classes of the deal
+	uint32_t tileCount;
+	uint32_t maxTiles;				// Every position with at most this many tiles is in the table
+	uint32_t storedResult;			// SOLVER_SOLVABLE if the won positions are stored, SOLVER_UNSOLVABLE if the lost ones
+	uint32_t padding;
+	uint64_t positionCount;			// Positions analysed, won or lost
+	uint64_t storedCount;			// Positions stored, the other ones have the opposite result
+	uint64_t bucketCount;
+	uint64_t slotCount;
+	uint64_t displacementsOffset;	// uint32[bucketCount], hash seed of each bucket
+	uint64_t slotsOffset;			// uint64[slotCount], key of a stored position, 0 for an empty slot
+};
+
+const char ENDGAME_MAGIC[4] = { 'M', 'J', 'E', 'G' };
+const uint32_t ENDGAME_VERSION = 1;
+
+enum SolverResult { SOLVER_UNSOLVABLE, SOLVER_SOLVABLE, SOLVER_UNKNOWN };
+
+// Tablebase of the endgames of one deal: every position with at most maxTiles tiles left is decided by
+// retrograde analysis, from the empty board upwards: a position is won when one of its pairs leads to a
+// won position with two tiles less. Positions are the sets of tiles left that can occur in a game, with
+// every tile lying on tiles still there and an even number of tiles in every match class.
+// Only the positions of the rarer result are stored, usually the lost ones: most small endgames can be won.
+// They are written to a file indexed by a perfect hash (hash and displace): keys are spread over buckets,
+// then every bucket gets the first seed sending all its keys to free slots. A lookup is two hashes and
+// one memory access, straight from the memory-mapped file.
+class EndgameTable {
+
+public:
+	// decides the endgames of the deal of a board and writes the table to a file
+	static void compile(const MahjongBitboard& deal, int maxTiles, const string& path) {
+		if (!MappedFile::writeAtomically(buildImage(deal, maxTiles), path)) {
+			throw runtime_error("Unable to write endgame table " + path);
+		}
+	}
+
+	// table kept in memory, never written to disk
+	static shared_ptr<const EndgameTable> build(const MahjongBitboard& deal, int maxTiles) {
+		return shared_ptr<const EndgameTable>(new EndgameTable(buildImage(deal, maxTiles), "in memory"));
+	}
+
+	static shared_ptr<const EndgameTable> open(const string& path) {
+		return shared_ptr<const EndgameTable>(new EndgameTable(path));
+	}
+
+	// true if the table was built for the deal of this board
+	bool matches(const MahjongBitboard& board) const {
+		return (int)header().tileCount == board.tileCount && header().dealKey == dealKey(board);
+	}
+
+	int maxTiles() const {
+		return (int)header().maxTiles;
+	}
+
+	long long positionCount() const {
+		return (long long)header().positionCount;
+	}
+
+	long long winCount() const {
+		const EndgameFileHeader& h = header();
+		return (long long)(h.storedResult == SOLVER_SOLVABLE ? h.storedCount : h.positionCount - h.storedCount);
+	}
+
+	// outcome of a position of the deal, SOLVER_UNKNOWN when more than maxTiles tiles are left
+	SolverResult probe(const TileSet& present) const {
+		if (present.count() > maxTiles()) return SOLVER_UNKNOWN;
+		const EndgameFileHeader& h = header();
+		uint64_t key = positionKey(present);
+		uint32_t displacement = section<uint32_t>(h.displacementsOffset)[bucketOf(key, h.bucketCount)];
+		bool stored = section<uint64_t>(h.slotsOffset)[slotOf(key, displacement, h.slotCount)] == key;
+		SolverResult other = h.storedResult == SOLVER_SOLVABLE ? SOLVER_UNSOLVABLE : SOLVER_SOLVABLE;
+		return stored ? (SolverResult)h.storedResult : other;
+	}
+
+	// appends the pairs clearing a won position of the table
+	void winningLine(MahjongBitboard board, vector<pair<int, int>>& line) const {
+		while (!board.isWon()) {
+			board.forEachLegalPair([&](int idx0, int idx1) {
+				board.present.reset(idx0);
+				board.present.reset(idx1);
+				if (probe(board.present) == SOLVER_SOLVABLE) {
+					line.push_back({ idx0, idx1 });
+					return true;
+				}
+				board.restoreTiles(idx0, idx1);
+				return false;
+			});
+		}
+	}
+
+	EndgameTable(const EndgameTable&) = delete;
+	EndgameTable& operator=(const EndgameTable&) = delete;
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	unique_ptr<MappedFile> file;	// Set when data is a view of a file, otherwise data points into image
+	vector<uint8_t> image;
+
+	EndgameTable(const string& path) {
+		file = make_unique<MappedFile>(path, "endgame table");
+		data = file->begin();
+		size = file->bytes();
+		validate(path);
+	}
+
+	EndgameTable(vector<uint8_t>&& image, const string& name) {
+		this->image = move(image);
+		data = this->image.data();
+		size = this->image.size();
+		validate(name);
+	}
+
+	const EndgameFileHeader& header() const {
+		return *(const EndgameFileHeader*)data;
+	}
+
+	template <class T>
+	const T* section(uint64_t offset) const {
+		return (const T*)(data + offset);
+	}
+
+	void validate(const string& name) const {
+		auto fail = [&](const string& reason) {
+			throw runtime_error("Invalid endgame table " + name + ": " + reason);
+		};
+		if (size < sizeof(EndgameFileHeader)) fail("file too short");
+		const EndgameFileHeader& h = header();
+		if (memcmp(h.magic, ENDGAME_MAGIC, 4) != 0) fail("not an endgame table");
+		if (h.version != ENDGAME_VERSION) fail("unsupported version " + to_string(h.version));
+		if (h.fileSize != size) fail("truncated file");
+		if (h.storedResult != SOLVER_SOLVABLE && h.storedResult != SOLVER_UNSOLVABLE) fail("bad stored result");
+		if (h.bucketCount == 0 || h.slotCount == 0) fail("empty hash");
+		if (h.displacementsOffset < sizeof(EndgameFileHeader) || h.displacementsOffset % 4 != 0 ||
+			h.displacementsOffset + h.bucketCount * sizeof(uint32_t) > size) fail("section out of bounds");
+		if (h.slotsOffset < sizeof(EndgameFileHeader) || h.slotsOffset % 8 != 0 ||
+			h.slotsOffset + h.slotCount * sizeof(uint64_t) > size) fail("section out of bounds");
+	}
+
+	// splitmix64 finalizer
+	static uint64_t mix(uint64_t z) {
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	// 0 marks the empty slots, so no key is ever 0
+	static uint64_t positionKey(const TileSet& present) {
+		uint64_t key = 0;
+		for (int w = 0; w < TILESET_WORDS; w++) key = mix(key ^ present.words[w] ^ (0x9e3779b97f4a7c15ULL * (w + 1)));
+		return key == 0 ? 1 : key;
+	}
+
+	static uint64_t bucketOf(uint64_t key, uint64_t bucketCount) {
+		return (key >> 32) % bucketCount;
+	}
+
+	static uint64_t slotOf(uint64_t key, uint32_t displacement, uint64_t slotCount) {
+		return mix(key ^ (0x9e3779b97f4a7c15ULL * displacement)) % slotCount;
+	}
+
+	// the same tiles with other suits or blockers make another deal
+	static uint64_t dealKey(const MahjongBitboard& board) {
+		uint64_t key = board.tileCount;
+		auto add = [&](uint64_t value) { key = mix(key ^ value); };
+		for (int idx = 0; idx < board.tileCount; idx++) {
+			add(board.matchClass[idx]);
+			for (int w = 0; w < TILESET_WORDS; w++) {
+				add(board.overMasks[idx].words[w]);
+				add(board.leftMasks[idx].words[w]);
+				add(board.rightMasks[idx].words[w]);
+			}
+		}
+		return key;
+	}
+
+	// Enumerates the positions of a given size: tiles are chosen class by class, an even number per class,
+	// and a choice is dropped as soon as a tile needed under a chosen one belongs to a class already done.
+	// Every subset of a class is tried, so classes are limited to MAX_CLASS_TILES tiles
+	struct PositionEnumerator {
+		static const int MAX_CLASS_TILES = 24;
+
+		const MahjongBitboard& board;
+		vector<TileSet> belowMasks;		// belowMasks[i] contains the tiles under tile i, even indirectly
+		vector<vector<int>> classTiles;
+		vector<TileSet> doneMasks;		// doneMasks[c] contains the tiles of classes 0 to c
+		int size = 0;					// Size of the positions being enumerated
+
+		PositionEnumerator(const MahjongBitboard& board) : board(board) {
+			vector<TileSet> underMasks(board.tileCount);
+			for (int idx = 0; idx < board.tileCount; idx++) {
+				board.overMasks[idx].forEach([&](int overIdx) { underMasks[overIdx].set(idx); });
+			}
+			belowMasks.resize(board.tileCount);
+			vector<char> done(board.tileCount, 0);
+			for (int idx = 0; idx < board.tileCount; idx++) computeBelow(underMasks, idx, done);
+			classTiles.resize(board.classMasks.size());
+			doneMasks.resize(board.classMasks.size());
+			TileSet doneTiles;
+			for (int c = 0; c < (int)classTiles.size(); c++) {
+				board.classMasks[c].forEach([&](int idx) { classTiles[c].push_back(idx); });
+				if ((int)classTiles[c].size() > MAX_CLASS_TILES) {
+					throw runtime_error("Endgame tables need match classes of at most " + to_string(MAX_CLASS_TILES) + " tiles, one has " + to_string(classTiles[c].size()));
+				}
+				doneTiles = doneTiles | board.classMasks[c];
+				doneMasks[c] = doneTiles;
+			}
+		}
+
+		const TileSet& computeBelow(const vector<TileSet>& underMasks, int idx, vector<char>& done) {
+			if (!done[idx]) {
+				done[idx] = 1;
+				TileSet below = underMasks[idx];
+				underMasks[idx].forEach([&](int underIdx) {
+					below = below | computeBelow(underMasks, underIdx, done);
+				});
+				belowMasks[idx] = below;
+			}
+			return belowMasks[idx];
+		}
+
+		template <class F>
+		void forEachPosition(int size, F f) {
+			this->size = size;
+			enumerate(0, TileSet(), TileSet(), size, f);
+		}
+
+		template <class F>
+		void enumerate(int c, const TileSet& chosen, const TileSet& needed, int left, F& f) {
+			if (c == (int)classTiles.size()) {
+				if (left == 0) f(chosen);
+				return;
+			}
+			const vector<int>& tiles = classTiles[c];
+			for (uint32_t subset = 0; subset < (1u << tiles.size()); subset++) {
+				int count = popcount64(subset);
+				if (count % 2 != 0 || count > left) continue;
+				TileSet nextChosen = chosen;
+				TileSet nextNeeded = needed;
+				for (int i = 0; i < (int)tiles.size(); i++) {
+					if ((subset >> i) & 1) {
+						nextChosen.set(tiles[i]);
+						nextNeeded = nextNeeded | belowMasks[tiles[i]];
+					}
+				}
+				if (((nextNeeded & doneMasks[c]) - nextChosen).any()) continue;
+				if ((nextChosen | nextNeeded).count() > size) continue;
+				enumerate(c + 1, nextChosen, nextNeeded, left - count, f);
+			}
+		}
+	};
+
+	static vector<uint8_t> buildImage(const MahjongBitboard& deal, int maxTiles) {
+		if (maxTiles < 0 || maxTiles > deal.tileCount) throw runtime_error("Endgame size out of range");
+		// retrograde analysis, size by size: only the won positions two tiles smaller are needed
+		PositionEnumerator enumerator(deal);
+		MahjongBitboard board = deal;
+		vector<uint64_t> wins;
+		vector<uint64_t> losses;
+		unordered_set<uint64_t> smallerWins;
+		unordered_set<uint64_t> sizeWins;
+		uint64_t positionCount = 0;
+		for (int size = 0; size <= maxTiles; size += 2) {
+			sizeWins.clear();
+			enumerator.forEachPosition(size, [&](const TileSet& position) {
+				positionCount++;
+				board.present = position;
+				uint64_t key = positionKey(position);
+				bool won = size == 0 || board.forEachLegalPair([&](int idx0, int idx1) {
+					TileSet next = position;
+					next.reset(idx0);
+					next.reset(idx1);
+					return smallerWins.count(positionKey(next)) > 0;
+				});
+				if (won) sizeWins.insert(key);
+				else losses.push_back(key);
+			});
+			wins.insert(wins.end(), sizeWins.begin(), sizeWins.end());
+			swap(smallerWins, sizeWins);
+		}
+		SolverResult storedResult = losses.size() <= wins.size() ? SOLVER_UNSOLVABLE : SOLVER_SOLVABLE;
+		vector<uint64_t>& keys = storedResult == SOLVER_UNSOLVABLE ? losses : wins;
+		sort(keys.begin(), keys.end());
+
+		// hash and displace: buckets of about 4 keys, a few free slots so that the last buckets place quickly
+		uint64_t bucketCount = max<uint64_t>(1, keys.size() / 4);
+		uint64_t slotCount = max<uint64_t>(1, keys.size() + keys.size() / 50 + 1);
+		vector<vector<uint64_t>> buckets(bucketCount);
+		for (uint64_t key : keys) buckets[bucketOf(key, bucketCount)].push_back(key);
+		vector<uint32_t> order(bucketCount);
+		for (uint32_t b = 0; b < bucketCount; b++) order[b] = b;
+		// largest buckets first, while the table is still empty
+		stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+		vector<uint32_t> displacements(bucketCount, 0);
+		vector<uint64_t> slots(slotCount, 0);
+		vector<uint64_t> placed;
+		for (uint32_t b : order) {
+			if (buckets[b].empty()) break;
+			for (uint32_t displacement = 0;; displacement++) {
+				if (displacement == UINT32_MAX) throw runtime_error("Unable to build the endgame hash");
+				placed.clear();
+				bool fits = true;
+				for (uint64_t key : buckets[b]) {
+					uint64_t slot = slotOf(key, displacement, slotCount);
+					if (slots[slot] != 0 || find(placed.begin(), placed.end(), slot) != placed.end()) {
+						fits = false;
+						break;
+					}
+					placed.push_back(slot);
+				}
+				if (!fits) continue;
+				for (int i = 0; i < (int)placed.size(); i++) slots[placed[i]] = buckets[b][i];
+				displacements[b] = displacement;
+				break;
+			}
+		}
+
+		EndgameFileHeader h = {};
+		memcpy(h.magic, ENDGAME_MAGIC, 4);
+		h.version = ENDGAME_VERSION;
+		h.dealKey = dealKey(deal);
+		h.tileCount = deal.tileCount;
+		h.maxTiles = maxTiles;
+		h.storedResult = storedResult;
+		h.positionCount = positionCount;
+		h.storedCount = keys.size();
+		h.bucketCount = bucketCount;
+		h.slotCount = slotCount;
+		h.displacementsOffset = sizeof(EndgameFileHeader);
+		// slots aligned on 8 bytes
+		h.slotsOffset = (h.displacementsOffset + bucketCount * sizeof(uint32_t) + 7) / 8 * 8;
+		h.fileSize = h.slotsOffset + slotCount * sizeof(uint64_t);
+		vector<uint8_t> image(h.fileSize, 0);
+		memcpy(image.data(), &h, sizeof(h));
+		memcpy(image.data() + h.displacementsOffset, displacements.data(), bucketCount * sizeof(uint32_t));
+		memcpy(image.data() + h.slotsOffset, slots.data(), slotCount * sizeof(uint64_t));
+		return image;
+	}
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include "MahjongSolver.hpp"
+#include <atomic>
+#include <climits>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// Looks for the best next pair on a worker thread so that the render loop never waits for a search.
+// Every board change cancels the search in progress and starts a new one. Results are published in a
+// single atomic word (board version + pair) which the render loop can read at any time without locking.
+class HintEngine {
+
+public:
+	HintEngine(int timeBudgetMs = 300, int lookaheadDepth = 2) {
+		this->timeBudgetMs = timeBudgetMs;
+		this->lookaheadDepth = lookaheadDepth;
+		solver.stopCondition = [this] { return isCancelled(); };
+		worker = thread([this] { workerLoop(); });
+	}
+
+	~HintEngine() {
+		{
+			lock_guard<mutex> lock(jobMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		worker.join();
+	}
+
+	// to be called whenever tiles are removed or a new game starts: the previous hint becomes stale
+	void boardChanged(const MahjongGame& game) {
+		// layouts larger than a bitboard get no hints: the version moves on, so no stale hint is shown
+		if (game.tiles.size() > MAHJONG_MAX_TILES) {
+			++version;
+			return;
+		}
+		unique_ptr<MahjongBitboard> board = make_unique<MahjongBitboard>(game);
+		{
+			lock_guard<mutex> lock(jobMutex);
+			pendingBoard = move(board);
+			pendingVersion = ++version;
+		}
+		wake.notify_one();
+	}
+
+	// tablebase of the deal being played, used from the next board change on, nullptr for none
+	void setEndgames(shared_ptr<const EndgameTable> table) {
+		lock_guard<mutex> lock(jobMutex);
+		pendingEndgames = table;
+	}
+
+	// returns true and the pair to suggest if a hint for the current board is available
+	// a pair of -1 means the search finished and there is no move left
+	bool getHint(int& idx0, int& idx1) const {
+		uint64_t packed = published.load(memory_order_acquire);
+		if ((uint32_t)(packed >> 32) != version.load(memory_order_acquire)) return false;
+		idx0 = unpackIndex(packed >> 16);
+		idx1 = unpackIndex(packed);
+		return true;
+	}
+
+private:
+	int timeBudgetMs;
+	int lookaheadDepth;
+	MahjongSolver solver{ 16 << 20 };
+	unique_ptr<DeadlockAnalyzer> analyzer;	// Built for the layout of the board being searched
+	const EndgameTable* endgames = nullptr;	// Tablebase of the board being searched, if any
+	thread worker;
+	mutex jobMutex;						// Protects the pending job and the stopping flag
+	condition_variable wake;
+	unique_ptr<MahjongBitboard> pendingBoard;
+	uint32_t pendingVersion = 0;
+	shared_ptr<const EndgameTable> pendingEndgames;
+	bool stopping = false;
+	atomic<uint32_t> version{ 0 };		// Version of the latest board handed to the engine
+	atomic<uint64_t> published{ ~0ULL };	// Version in the high 32 bits, then the two tile indexes on 16 bits each
+	uint32_t searchVersion = 0;			// Version of the board being searched by the worker
+	chrono::steady_clock::time_point deadline;
+
+	static_assert(LAYOUT_MAX_TILES <= 0xFFFF, "tile indexes of a layout must fit 16 bits and never be 0xFFFF");
+
+	static int unpackIndex(uint64_t bits) {
+		uint16_t idx = (uint16_t)bits;
+		return idx == 0xFFFF ? -1 : idx;
+	}
+
+	void publish(int idx0, int idx1) {
+		uint64_t packed = ((uint64_t)searchVersion << 32) | ((uint64_t)(uint16_t)idx0 << 16) | (uint16_t)idx1;
+		published.store(packed, memory_order_release);
+	}
+
+	bool isCancelled() const {
+		return version.load(memory_order_relaxed) != searchVersion || chrono::steady_clock::now() > deadline;
+	}
+
+	void workerLoop() {
+		while (true) {
+			unique_ptr<MahjongBitboard> board;
+			{
+				unique_lock<mutex> lock(jobMutex);
+				wake.wait(lock, [this] { return stopping || pendingBoard; });
+				if (stopping) return;
+				board = move(pendingBoard);
+				searchVersion = pendingVersion;
+				solver.endgames = pendingEndgames;
+			}
+			deadline = chrono::steady_clock::now() + chrono::milliseconds(timeBudgetMs);
+			search(*board);
+		}
+	}
+
+	void search(MahjongBitboard& board) {
+		// quick answer first: the pair leaving the most options open within the lookahead
+		analyzer = make_unique<DeadlockAnalyzer>(board);
+		endgames = solver.endgames && solver.endgames->matches(board) ? solver.endgames.get() : nullptr;
+		int best0 = -1, best1 = -1;
+		int bestScore = INT_MIN;
+		board.forEachLegalPair([&](int idx0, int idx1) {
+			board.present.reset(idx0);
+			board.present.reset(idx1);
+			int score = mobility(board, lookaheadDepth - 1);
+			board.restoreTiles(idx0, idx1);
+			if (score > bestScore) {
+				bestScore = score;
+				best0 = idx0;
+				best1 = idx1;
+			}
+			return isCancelled();
+		});
+		if (version.load(memory_order_relaxed) != searchVersion) return;
+		publish(best0, best1);
+		// then refine with the exact solver while there is time: its first move always leads to a win
+		if (best0 != -1 && solver.solve(board) == SOLVER_SOLVABLE) {
+			publish(solver.solution[0].first, solver.solution[0].second);
+		}
+	}
+
+	// best number of legal pairs reachable within the given number of moves
+	int mobility(MahjongBitboard& board, int depth) {
+		if (board.isWon()) return INT_MAX;
+		// a lost position scores below any other, even one with fewer moves
+		if (analyzer->isDeadlocked(board)) return -1;
+		if (endgames && board.present.count() <= endgames->maxTiles()) {
+			return endgames->probe(board.present) == SOLVER_SOLVABLE ? INT_MAX : -1;
+		}
+		int moves = 0;
+		int best = -1;
+		board.forEachLegalPair([&](int idx0, int idx1) {
+			moves++;
+			if (depth > 0) {
+				board.present.reset(idx0);
+				board.present.reset(idx1);
+				best = max(best, mobility(board, depth - 1));
+				board.restoreTiles(idx0, idx1);
+			}
+			return false;
+		});
+		return depth > 0 ? best : moves;
+	}
+};
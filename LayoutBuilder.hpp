@@ -0,0 +1,111 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Neighbour relations stored for every tile, in this order
+enum NeighbourRelation { NEIGHBOURS_OVER, NEIGHBOURS_UNDER, NEIGHBOURS_LEFT, NEIGHBOURS_RIGHT, NEIGHBOUR_RELATIONS };
+
+// Layout held in plain vectors, as read from a structure before being compiled
+struct LayoutSource {
+	vector<glm::vec3> positions;		// Center of each tile
+	vector<int> suits;					// Suits dealt over the tiles, one per tile
+	vector<vector<int>> groups;			// Suits removable together, empty to use the rules of the standard set
+	vector<vector<int>> neighbours;		// neighbours[idx * NEIGHBOUR_RELATIONS + relation], sorted by index
+};
+
+// Size of a tile along each axis, tx ty tz in python/structure.ipynb
+struct TileDimensions {
+	float width;		// Along x, tiles of a row touch each other on this side
+	float height;		// Along y, distance between two levels
+	float depth;		// Along z
+};
+
+// Computes the blocking relations of a layout from the positions of its tiles.
+// Tiles are bucketed in a hash grid with cells as large as a tile, so every tile is only compared with
+// the tiles of the few cells around it and the whole layout is processed in linear time.
+// Two tiles of the same level are left/right neighbours when they touch side by side and overlap along z,
+// a tile is over another one when it lies on the next level and their footprints overlap.
+class LayoutBuilder {
+
+public:
+	static void inferNeighbours(LayoutSource& source, TileDimensions size) {
+		int tileCount = (int)source.positions.size();
+		// tolerance on distances, positions come from rounded decimals
+		const float eps = 1e-3f;
+		unordered_map<uint64_t, vector<int>> grid;
+		grid.reserve(tileCount);
+		for (int idx = 0; idx < tileCount; idx++) {
+			grid[cellKey(cellOf(source.positions[idx], size))].push_back(idx);
+		}
+		source.neighbours.assign((size_t)tileCount * NEIGHBOUR_RELATIONS, {});
+		for (int idx = 0; idx < tileCount; idx++) {
+			glm::vec3 position = source.positions[idx];
+			glm::ivec3 cell = cellOf(position, size);
+			// a neighbour is at most one tile away on every axis, rounding can push it one more cell away
+			for (int dx = -2; dx <= 2; dx++) {
+				for (int dy = -1; dy <= 1; dy++) {
+					for (int dz = -2; dz <= 2; dz++) {
+						auto bucket = grid.find(cellKey(cell + glm::ivec3(dx, dy, dz)));
+						if (bucket == grid.end()) continue;
+						for (int other : bucket->second) {
+							if (other == idx) continue;
+							glm::vec3 offset = (source.positions[other] - position) / glm::vec3(size.width, size.height, size.depth);
+							bool overlapX = abs(offset.x) < 1.0f - eps;
+							bool overlapZ = abs(offset.z) < 1.0f - eps;
+							if (abs(offset.y) < eps && overlapZ) {
+								if (abs(offset.x - 1.0f) < eps) source.neighbours[idx * NEIGHBOUR_RELATIONS + NEIGHBOURS_RIGHT].push_back(other);
+								if (abs(offset.x + 1.0f) < eps) source.neighbours[idx * NEIGHBOUR_RELATIONS + NEIGHBOURS_LEFT].push_back(other);
+							}
+							else if (overlapX && overlapZ) {
+								if (abs(offset.y - 1.0f) < eps) source.neighbours[idx * NEIGHBOUR_RELATIONS + NEIGHBOURS_OVER].push_back(other);
+								if (abs(offset.y + 1.0f) < eps) source.neighbours[idx * NEIGHBOUR_RELATIONS + NEIGHBOURS_UNDER].push_back(other);
+							}
+						}
+					}
+				}
+			}
+		}
+		for (vector<int>& list : source.neighbours) sort(list.begin(), list.end());
+	}
+
+	// returns a description of the first tile whose neighbours differ between two layouts, empty if none does
+	static string compareNeighbours(const LayoutSource& expected, const LayoutSource& actual) {
+		const char* relationNames[NEIGHBOUR_RELATIONS] = { "over", "under", "left", "right" };
+		for (size_t row = 0; row < expected.neighbours.size() && row < actual.neighbours.size(); row++) {
+			vector<int> expectedList = expected.neighbours[row];
+			vector<int> actualList = actual.neighbours[row];
+			sort(expectedList.begin(), expectedList.end());
+			sort(actualList.begin(), actualList.end());
+			if (expectedList != actualList) {
+				return "tile " + to_string(row / NEIGHBOUR_RELATIONS) + " has " + listToString(expectedList) + " " +
+					relationNames[row % NEIGHBOUR_RELATIONS] + ", positions give " + listToString(actualList);
+			}
+		}
+		if (expected.neighbours.size() != actual.neighbours.size()) return "different number of tiles";
+		return "";
+	}
+
+private:
+	static glm::ivec3 cellOf(glm::vec3 position, TileDimensions size) {
+		return glm::ivec3((int)floor(position.x / size.width), (int)round(position.y / size.height), (int)floor(position.z / size.depth));
+	}
+
+	// packs the three coordinates of a cell in 21 bits each
+	static uint64_t cellKey(glm::ivec3 cell) {
+		const uint64_t mask = (1 << 21) - 1;
+		return (((uint64_t)cell.x & mask) << 42) | (((uint64_t)cell.y & mask) << 21) | ((uint64_t)cell.z & mask);
+	}
+
+	static string listToString(const vector<int>& list) {
+		string result = "[";
+		for (int i = 0; i < (int)list.size(); i++) result += (i > 0 ? ", " : "") + to_string(list[i]);
+		return result + "]";
+	}
+};
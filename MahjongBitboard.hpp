@@ -0,0 +1,225 @@
+#pragma once
+#include "MahjongGame.hpp"
+#include <cstdint>
+#include <stdexcept>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+// Maximum number of tiles a bitboard can hold, can be raised at compile time for larger layouts
+#ifndef MAHJONG_MAX_TILES
+#define MAHJONG_MAX_TILES 256
+#endif
+
+const int TILESET_WORDS = (MAHJONG_MAX_TILES + 63) / 64;
+
+// Count the bits set in a 64-bit word
+inline int popcount64(uint64_t word) {
+#ifdef _MSC_VER
+	return (int)__popcnt64(word);
+#else
+	return __builtin_popcountll(word);
+#endif
+}
+
+// Index of the lowest bit set in a non-zero 64-bit word
+inline int lowestBit64(uint64_t word) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return (int)index;
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+// Fixed-width set of tile indexes, one bit per tile: copying it never touches the heap
+struct TileSet {
+	uint64_t words[TILESET_WORDS] = {};
+
+	void set(int idx) { words[idx >> 6] |= (uint64_t)1 << (idx & 63); }
+	void reset(int idx) { words[idx >> 6] &= ~((uint64_t)1 << (idx & 63)); }
+	bool test(int idx) const { return (words[idx >> 6] >> (idx & 63)) & 1; }
+
+	bool any() const {
+		for (int w = 0; w < TILESET_WORDS; w++) {
+			if (words[w]) return true;
+		}
+		return false;
+	}
+
+	bool none() const { return !any(); }
+
+	// returns true if the two sets share at least one tile
+	bool intersects(const TileSet& other) const {
+		for (int w = 0; w < TILESET_WORDS; w++) {
+			if (words[w] & other.words[w]) return true;
+		}
+		return false;
+	}
+
+	int count() const {
+		int result = 0;
+		for (int w = 0; w < TILESET_WORDS; w++) {
+			result += popcount64(words[w]);
+		}
+		return result;
+	}
+
+	// returns the lowest tile index in the set, -1 if the set is empty
+	int first() const {
+		for (int w = 0; w < TILESET_WORDS; w++) {
+			if (words[w]) return (w << 6) + lowestBit64(words[w]);
+		}
+		return -1;
+	}
+
+	// calls f(idx) for every tile index in the set, in increasing order
+	template <class F>
+	void forEach(F f) const {
+		for (int w = 0; w < TILESET_WORDS; w++) {
+			uint64_t word = words[w];
+			while (word) {
+				f((w << 6) + lowestBit64(word));
+				word &= word - 1;
+			}
+		}
+	}
+
+	TileSet operator&(const TileSet& other) const {
+		TileSet result;
+		for (int w = 0; w < TILESET_WORDS; w++) result.words[w] = words[w] & other.words[w];
+		return result;
+	}
+
+	TileSet operator|(const TileSet& other) const {
+		TileSet result;
+		for (int w = 0; w < TILESET_WORDS; w++) result.words[w] = words[w] | other.words[w];
+		return result;
+	}
+
+	// tiles of this set that are not in the other one
+	TileSet operator-(const TileSet& other) const {
+		TileSet result;
+		for (int w = 0; w < TILESET_WORDS; w++) result.words[w] = words[w] & ~other.words[w];
+		return result;
+	}
+
+	bool operator==(const TileSet& other) const {
+		for (int w = 0; w < TILESET_WORDS; w++) {
+			if (words[w] != other.words[w]) return false;
+		}
+		return true;
+	}
+
+	bool operator!=(const TileSet& other) const { return !(*this == other); }
+};
+
+// Game state stored as a bitset of the tiles on the board.
+// Blocker masks are derived once from the over/left/right lists of the layout of a MahjongGame, after that
+// every query is a handful of AND/popcount operations and no heap allocation takes place.
+class MahjongBitboard {
+
+public:
+	int tileCount = 0;
+	TileSet present;					// Tiles still on the board
+	vector<TileSet> overMasks;			// overMasks[i] contains the tiles lying on top of tile i
+	vector<TileSet> leftMasks;			// leftMasks[i] contains the tiles touching tile i on the left
+	vector<TileSet> rightMasks;			// rightMasks[i] contains the tiles touching tile i on the right
+	vector<int> matchClass;				// Suit vector index of each tile, tiles with the same class can be removed together
+	vector<TileSet> classMasks;			// classMasks[c] contains all the tiles whose match class is c
+
+	MahjongBitboard(const MahjongGame& game) {
+		tileCount = (int)game.tiles.size();
+		if (tileCount > MAHJONG_MAX_TILES) {
+			throw runtime_error("Layout has " + to_string(tileCount) + " tiles, bitboards hold at most " + to_string(MAHJONG_MAX_TILES));
+		}
+		overMasks.resize(tileCount);
+		leftMasks.resize(tileCount);
+		rightMasks.resize(tileCount);
+		matchClass.resize(tileCount);
+		classMasks.resize(game.suitVectors.size());
+		for (const Tile& tile : game.tiles) {
+			int idx = tile.tileIdx;
+			for (int overIdx : game.layout->over(idx)) overMasks[idx].set(overIdx);
+			for (int leftIdx : game.layout->left(idx)) leftMasks[idx].set(leftIdx);
+			for (int rightIdx : game.layout->right(idx)) rightMasks[idx].set(rightIdx);
+			matchClass[idx] = tile.getSuitVectorIndex();
+			classMasks[matchClass[idx]].set(idx);
+			if (!tile.isRemoved) present.set(idx);
+		}
+	}
+
+	// returns true if the tile is on the board, has nothing on top and at least one free side
+	bool isOpen(int idx) const {
+		return present.test(idx) && !present.intersects(overMasks[idx]) &&
+			(!present.intersects(leftMasks[idx]) || !present.intersects(rightMasks[idx]));
+	}
+
+	// same rules as MahjongGame::canRemoveTiles
+	bool canRemoveTiles(int idx0, int idx1) const {
+		return idx0 != idx1 && matchClass[idx0] == matchClass[idx1] && isOpen(idx0) && isOpen(idx1);
+	}
+
+	void removeTiles(int idx0, int idx1) {
+		if (canRemoveTiles(idx0, idx1)) {
+			present.reset(idx0);
+			present.reset(idx1);
+		}
+	}
+
+	// puts back on the board a pair previously removed with removeTiles
+	void restoreTiles(int idx0, int idx1) {
+		present.set(idx0);
+		present.set(idx1);
+	}
+
+	TileSet openTiles() const {
+		TileSet result;
+		present.forEach([&](int idx) {
+			if (isOpen(idx)) result.set(idx);
+		});
+		return result;
+	}
+
+	// calls f(idx0, idx1) for every pair that can be removed, stops as soon as f returns true
+	// returns true if it was stopped early
+	template <class F>
+	bool forEachLegalPair(F f) const {
+		return forEachLegalPair(openTiles(), f);
+	}
+
+	// same as above, with the open tiles already known
+	template <class F>
+	bool forEachLegalPair(const TileSet& open, F f) const {
+		for (const TileSet& classMask : classMasks) {
+			TileSet candidates = open & classMask;
+			while (candidates.any()) {
+				int idx0 = candidates.first();
+				candidates.reset(idx0);
+				TileSet partners = candidates;
+				while (partners.any()) {
+					int idx1 = partners.first();
+					partners.reset(idx1);
+					if (f(idx0, idx1)) return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool isWon() const {
+		return present.none();
+	}
+
+	bool isGameOver() const {
+		if (isWon()) return false;
+		TileSet open = openTiles();
+		for (const TileSet& classMask : classMasks) {
+			if ((open & classMask).count() > 1) return false;
+		}
+		return true;
+	}
+};
@@ -1,121 +1,245 @@
+#pragma once
 #include "Tile.hpp"
-#include <json.hpp>
+#include "MahjongLayout.hpp"
 #include <iostream>
-#include <fstream>
 #include <algorithm>
 #include <random>
 #include <glm/gtx/string_cast.hpp>
 
-using json = nlohmann::json;
 using namespace std;
 
+// How suits are distributed over the board when a game is created
+enum DealMode {
+	DEAL_RANDOM,		// Plain shuffle, the deal might be unwinnable
+	DEAL_SOLVABLE		// Deal built backwards from matching pairs, always winnable
+};
+
+// Random generator of the deals. Only the sequence of mt19937_64 is fixed by the standard, shuffle and
+// distributions are not, so the shuffle is written here: a seed gives the same deal on every platform
+struct DealRandom {
+	mt19937_64 engine;
+
+	// integer in [0, n), the bias of the modulo is negligible for the sizes of a deal
+	int below(int n) {
+		return (int)(engine() % (uint64_t)n);
+	}
+
+	// Fisher-Yates shuffle
+	template <class T>
+	void shuffle(vector<T>& values) {
+		for (int i = (int)values.size() - 1; i > 0; i--) {
+			swap(values[i], values[below(i + 1)]);
+		}
+	}
+};
+
 class MahjongGame {
 
 public:
+	shared_ptr<const MahjongLayout> layout;	// Positions and neighbours of the tiles, shared and never modified
 	vector<Tile> tiles;
-	vector<int> suitVectors[36];	// Array of vectors of int, having in position i a vector containing the indexes of the tiles removable together
-
-	MahjongGame(string path) {
-		// open Input File Stream (ifstream) associated to structure json
-		ifstream f(path);
-		// parse structure as json
-		json data = json::parse(f);
-		// close stream, not needed anymore after parsing
-		f.close();
-		// convert json information into list of tiles
-		// import array of suit indices
-		vector<int> suits;
-		for (auto& el : data["suits"].items())
-		{
-			suits.push_back(el.value());
-		}
-		// randomize array of indices
-		// based on https://stackoverflow.com/a/6926473
-		auto rd = random_device{};
-		auto rng = default_random_engine{ rd() };
-		shuffle(suits.begin(), suits.end(), rng);
-		// work with array of tiles
-		for (auto& el : data["tiles"].items()) {
-			json tile = el.value();
-			int tileIdx = tile["tileIdx"];
-			vector<int> under;
-			vector<int> over;
-			vector<int> left;
-			vector<int> right;
-			// import bottom vector
-			for (auto& uel : tile["under"].items()) {
-				under.push_back(uel.value());
-			}
-			// import top vector
-			for (auto& oel : tile["over"].items()) {
-				over.push_back(oel.value());
-			}
-			// import left vector
-			for (auto& lel : tile["left"].items()) {
-				left.push_back(lel.value());
-			}
-			// import right vector
-			for (auto& rel : tile["right"].items()) {
-				right.push_back(rel.value());
-			}
-			// import position vector
-			vector<double> coords;
-			for (auto& coord : tile["position"].items()) {
-				coords.push_back(coord.value());
+	vector<vector<int>> suitVectors;	// Vector of vectors of int, having in position i a vector containing the indexes of the tiles removable together
+	uint64_t seed = 0;				// Seed of the current deal: the same layout, mode and seed always give the same deal
+	DealMode dealMode = DEAL_RANDOM;
+
+	MahjongGame(string path, DealMode mode = DEAL_RANDOM, uint64_t seed = randomSeed()) : MahjongGame(MahjongLayout::open(path), mode, seed) {}
+
+	MahjongGame(shared_ptr<const MahjongLayout> layout, DealMode mode = DEAL_RANDOM, uint64_t seed = randomSeed()) {
+		this->layout = layout;
+		// one suit vector for each group of suits of the layout
+		suitVectors.resize(layout->groupCount());
+		openVectors.resize(layout->groupCount());
+		for (int group = 0; group < layout->groupCount(); group++) {
+			for (int suit : layout->groupSuits(group)) {
+				if (suit >= (int)suitGroups.size()) suitGroups.resize(suit + 1, -1);
+				suitGroups[suit] = group;
 			}
-			glm::vec3 position = glm::vec3(coords[0], coords[1], coords[2]);
-			Tile newTile = Tile(tileIdx, suits[tileIdx], over, under, left, right, position);
-			tiles.push_back(newTile);
-			suitVectors[newTile.getSuitVectorIndex()].push_back(tileIdx);
 		}
+		for (int tileIdx = 0; tileIdx < layout->tileCount(); tileIdx++) {
+			tiles.push_back(Tile(tileIdx, 0, 0, 0, 0));
+		}
+		newGame(mode, seed);
+	}
+
+	// seed for a deal nobody asked for in particular
+	static uint64_t randomSeed() {
+		random_device rd;
+		return ((uint64_t)rd() << 32) ^ rd();
+	}
+
+	// deals the suits again and puts every tile back on the board: the layout is left untouched
+	// and the storage of the previous game is reused
+	void newGame(DealMode mode = DEAL_RANDOM, uint64_t seed = randomSeed()) {
+		this->seed = seed;
+		dealMode = mode;
+		rng.engine.seed(seed);
+		// suits of the layout, dealt over the tiles below
+		suits.assign(layout->suits().begin(), layout->suits().end());
+		for (Tile& tile : tiles) {
+			tile.overCount = layout->over(tile.tileIdx).size();
+			tile.leftCount = layout->left(tile.tileIdx).size();
+			tile.rightCount = layout->right(tile.tileIdx).size();
+			tile.isRemoved = false;
+		}
+		if (mode == DEAL_SOLVABLE) {
+			if (!dealSolvable(suits, rng, dealtPairs)) throw runtime_error("Unable to build a solvable deal for this layout");
+		}
+		else {
+			// randomize array of indices
+			// based on https://stackoverflow.com/a/6926473
+			rng.shuffle(suits);
+			for (Tile& tile : tiles) tile.suitIdx = suits[tile.tileIdx];
+		}
+		for (vector<int>& suitVector : suitVectors) suitVector.clear();
+		for (Tile& tile : tiles) {
+			tile.groupIdx = suitGroups[tile.suitIdx];
+			suitVectors[tile.getSuitVectorIndex()].push_back(tile.tileIdx);
+		}
+		undoStack.clear();
+		redoStack.clear();
+		reshuffles.clear();
+		initOpenTiles();
+		markAllChanged();
+	}
+
+	// puts the game in a saved state, given the suit of every tile and whether it has been removed.
+	// Counters are rebuilt from the layout, the move journal is cleared. The board is checked before
+	// anything is changed: the suits must be the ones newGame deals on the layout, and every group must
+	// have an even count of tiles left, otherwise the game could never be won
+	template <class SuitOf, class IsRemoved>
+	void restoreBoard(SuitOf suitOf, IsRemoved isRemoved) {
+		vector<int> suitsLeft(suitGroups.size(), 0);	// suits of the layout not found on the board yet
+		vector<int> groupPresent(suitVectors.size(), 0);
+		for (int suit : layout->suits()) suitsLeft[suit]++;
+		for (const Tile& tile : tiles) {
+			int suit = suitOf(tile.tileIdx);
+			if (suit < 0 || suit >= (int)suitGroups.size() || suitGroups[suit] < 0) throw runtime_error("Suit " + to_string(suit) + " is not part of the layout");
+			if (--suitsLeft[suit] < 0) throw runtime_error("Suit " + to_string(suit) + " is on more tiles than the layout deals");
+			if (!isRemoved(tile.tileIdx)) groupPresent[suitGroups[suit]]++;
+		}
+		for (int count : groupPresent) {
+			if (count % 2 != 0) throw runtime_error("A group of suits has an odd number of tiles left on the board");
+		}
+		for (Tile& tile : tiles) {
+			tile.suitIdx = suitOf(tile.tileIdx);
+			tile.groupIdx = suitGroups[tile.suitIdx];
+			tile.isRemoved = isRemoved(tile.tileIdx);
+		}
+		for (Tile& tile : tiles) {
+			tile.overCount = countPresent(layout->over(tile.tileIdx));
+			tile.leftCount = countPresent(layout->left(tile.tileIdx));
+			tile.rightCount = countPresent(layout->right(tile.tileIdx));
+		}
+		for (vector<int>& suitVector : suitVectors) suitVector.clear();
+		for (Tile& tile : tiles) {
+			if (!tile.isRemoved) suitVectors[tile.getSuitVectorIndex()].push_back(tile.tileIdx);
+		}
+		undoStack.clear();
+		redoStack.clear();
+		reshuffles.clear();
+		initOpenTiles();
+		markAllChanged();
+	}
+
+	// deals again the suits of the tiles still on the board, so that the game can be won from there.
+	// Moves made before cannot be undone anymore, nor moves undone redone. Returns false and
+	// leaves the board untouched if no deal of the remaining positions can be won, e.g. when the only
+	// tiles left are stacked on each other
+	bool reshuffle(uint64_t seed = randomSeed()) {
+		DealRandom reshuffleRng;
+		reshuffleRng.engine.seed(seed);
+		vector<int> previousSuits(tiles.size());
+		suits.clear();
+		for (Tile& tile : tiles) {
+			previousSuits[tile.tileIdx] = tile.suitIdx;
+			if (!tile.isRemoved) suits.push_back(tile.suitIdx);
+		}
+		// the order the pairs were placed in, taken backwards, is a winning line: replaying it checks the deal
+		if (!dealSolvable(suits, reshuffleRng, dealtPairs) || !winsBackwards(dealtPairs)) {
+			for (Tile& tile : tiles) tile.suitIdx = previousSuits[tile.tileIdx];
+			return false;
+		}
+		for (vector<int>& suitVector : suitVectors) suitVector.clear();
+		for (Tile& tile : tiles) {
+			tile.groupIdx = suitGroups[tile.suitIdx];
+			if (!tile.isRemoved) suitVectors[tile.getSuitVectorIndex()].push_back(tile.tileIdx);
+		}
+		redoStack.clear();
+		reshuffles.push_back({ (int)undoStack.size(), seed });
+		initOpenTiles();
+		markAllChanged();
+		return true;
 	}
 
 	//returns true if the two tiles whose tile_indexes are passed as parameters can be removed from the game together
 	bool canRemoveTiles(int idx0, int idx1) {
-		Tile tile0 = tiles[idx0];
-		Tile tile1 = tiles[idx1];
-		int suitIdx0 = tile0.suitIdx;
-		int suitIdx1 = tile1.suitIdx;
-		bool result = (((suitIdx0 < 40 && suitIdx1 == suitIdx0) ||
-			(suitIdx0 >= 40 && suitIdx0 < 44 && suitIdx1 >= 40 && suitIdx1 < 44) ||
-			(suitIdx0 >= 44 && suitIdx0 < 48 && suitIdx1 >= 44 && suitIdx1 < 48)) && tile0.isOpen() && tile1.isOpen() && idx0!=idx1);
+		const Tile& tile0 = tiles[idx0];
+		const Tile& tile1 = tiles[idx1];
+		bool result = (tile0.groupIdx == tile1.groupIdx && tile0.isOpen() && tile1.isOpen() && !tile0.isRemoved && !tile1.isRemoved && idx0!=idx1);
 		
 		return result;
 	}
 
 	void removeTiles(int idx0, int idx1) {
-		// access tiles
-		Tile tile0 = tiles[idx0];
-		Tile tile1 = tiles[idx1];
-		int suitIdx0 = tile0.suitIdx;
-		int suitIdx1 = tile1.suitIdx;
-		// check on suit idx
-		if (((suitIdx0 < 40 && suitIdx1 == suitIdx0) ||
-			(suitIdx0 >= 40 && suitIdx0 < 44 && suitIdx1 >= 40 && suitIdx1 < 44) ||
-			(suitIdx0 >= 44 && suitIdx0 < 48 && suitIdx1 >= 44 && suitIdx1 < 48)) && tile0.isOpen() && tile1.isOpen() && idx0 != idx1) {
-			// for each tile, remove its index from neighbours
-			for (Tile tile : {tile0, tile1}) {
-				// remove current tile index from neighbors
-				for (int leftIdx : tile.left) {
-					tiles[leftIdx].right.erase(remove(tiles[leftIdx].right.begin(), tiles[leftIdx].right.end(), tile.tileIdx), tiles[leftIdx].right.end());
-				}
-				for (int rightIdx : tile.right) {
-					tiles[rightIdx].left.erase(remove(tiles[rightIdx].left.begin(), tiles[rightIdx].left.end(), tile.tileIdx), tiles[rightIdx].left.end());
-				}
-				for (int underIdx : tile.under) {
-					tiles[underIdx].over.erase(remove(tiles[underIdx].over.begin(), tiles[underIdx].over.end(), tile.tileIdx), tiles[underIdx].over.end());
-				}
-				// set current tile as removed
-				tiles[tile.tileIdx].isRemoved = true;
-				// remove current tile from related suit vector
-				int svi = tile.getSuitVectorIndex();
-				suitVectors[svi].erase(remove(suitVectors[svi].begin(), suitVectors[svi].end(), tile.tileIdx), suitVectors[svi].end());
-			}
+		if (canRemoveTiles(idx0, idx1)) {
+			applyRemoval(idx0, idx1);
+			undoStack.push_back({ (uint16_t)idx0, (uint16_t)idx1 });
+			// a new move invalidates the moves that were undone
+			redoStack.clear();
 		}
 	}
 
+	// pairs removed so far and not undone, in order
+	vector<pair<int, int>> getMoves() const {
+		vector<pair<int, int>> moves;
+		for (const MoveRecord& move : undoStack) moves.push_back({ move.idx0, move.idx1 });
+		return moves;
+	}
+
+	// reshuffle of the game: the seed it was dealt with and the number of pairs removed before it
+	struct Reshuffle {
+		int moveCount;
+		uint64_t seed;
+	};
+
+	// reshuffles done so far, in order
+	const vector<Reshuffle>& getReshuffles() const {
+		return reshuffles;
+	}
+
+	// a reshuffle cannot be undone, nor the moves made before it
+	bool canUndo() {
+		return !undoStack.empty() && (reshuffles.empty() || (int)undoStack.size() > reshuffles.back().moveCount);
+	}
+
+	bool canRedo() {
+		return !redoStack.empty();
+	}
+
+	// puts back the last pair removed, returns false if there is nothing to undo
+	bool undo() {
+		if (!canUndo()) return false;
+		MoveRecord move = undoStack.back();
+		undoStack.pop_back();
+		// tiles are restored in reverse order, so that every neighbour list gets back exactly what it lost
+		restoreTile(move.idx1);
+		restoreTile(move.idx0);
+		redoStack.push_back(move);
+		return true;
+	}
+
+	// removes again the last pair put back by undo, returns false if there is nothing to redo
+	bool redo() {
+		if (redoStack.empty()) return false;
+		MoveRecord move = redoStack.back();
+		redoStack.pop_back();
+		applyRemoval(move.idx0, move.idx1);
+		undoStack.push_back(move);
+		return true;
+	}
+
 	void printSuitVectors() {
-		for (int i = 0; i < 36; i++) {
+		for (int i = 0; i < (int)suitVectors.size(); i++) {
 			cout << "Vector " << i << ": [";
 			for (int index : suitVectors[i]) {
 				cout << index << ", ";
@@ -124,23 +248,321 @@ public:
 		}
 	}
 
-	bool isGameOver() {
-		if (isWon()) return false;
-		for (vector<int> suitVector : suitVectors) {
-			int count = 0;
-			for (int index : suitVector) {
-				if (tiles[index].isOpen()) count++;
+	// returns the pairs of tiles that can be removed in the current state
+	vector<pair<int, int>> getLegalPairs() {
+		vector<pair<int, int>> pairs;
+		for (const vector<int>& openVector : openVectors) {
+			for (int i = 0; i < (int)openVector.size(); i++) {
+				for (int j = i + 1; j < (int)openVector.size(); j++) {
+					pairs.push_back({ openVector[i], openVector[j] });
+				}
 			}
-			if (count > 1) return false;
 		}
-		return true;
+		return pairs;
+	}
+
+	bool isGameOver() const {
+		return !isWon() && movableGroups == 0;
+	}
+
+	bool isWon() const {
+		return remainingTiles == 0;
+	}
+
+	// hands over the tiles whose suit or removed state changed since the last call, each one listed
+	// once, so that a view of the board only updates those. The game keeps a single list: one reader
+	void takeChangedTiles(vector<int>& changed) {
+		changed.clear();
+		changed.swap(changedTiles);
+		for (int idx : changed) changedFlags[idx] = 0;
 	}
 
-	bool isWon() {
-		for (Tile tile : tiles) {
-			if (!tile.isRemoved) return false;
+private:
+	// Entry of the move journal: a removed pair fits in 4 bytes
+	struct MoveRecord {
+		uint16_t idx0;
+		uint16_t idx1;
+	};
+	static_assert(LAYOUT_MAX_TILES <= UINT16_MAX + 1u, "tile indexes of a layout must fit a MoveRecord");
+
+	DealRandom rng;					// Generator used to deal the suits, seeded by newGame
+	vector<int> suits;				// Suits being dealt, kept to reuse its storage
+	vector<MoveRecord> undoStack;	// Pairs removed so far, last one on top
+	vector<MoveRecord> redoStack;	// Pairs put back by undo, last one on top
+	vector<Reshuffle> reshuffles;	// Reshuffles done since the deal, in order
+	vector<bool> openFlags;			// openFlags[i] is true if tile i is currently open
+	vector<vector<int>> openVectors;	// Vector of vectors of int, having in position i the indexes of the open tiles of suit vector i
+	vector<int> suitGroups;			// suitGroups[s] is the suit vector of the tiles of suit s
+	int movableGroups = 0;			// Number of suit vectors with at least two open tiles
+	int remainingTiles = 0;			// Number of tiles still on the board
+	vector<char> fillScratch;		// Buffers used by canFillRemaining
+	vector<int> fillOpen;
+	vector<pair<int, int>> dealtPairs;	// Positions of the pairs placed by the last solvable deal, in order
+	vector<int> changedTiles;		// Tiles changed since the last takeChangedTiles, at most once each
+	vector<char> changedFlags;		// changedFlags[i] is 1 if tile i is in changedTiles
+
+	void markChanged(int idx) {
+		if (changedFlags[idx]) return;
+		changedFlags[idx] = 1;
+		changedTiles.push_back(idx);
+	}
+
+	void markAllChanged() {
+		changedFlags.resize(tiles.size());
+		for (Tile& tile : tiles) markChanged(tile.tileIdx);
+	}
+
+	// remove a legal pair from the board, updating neighbour counters, suit vectors and open state
+	void applyRemoval(int idx0, int idx1) {
+		for (int idx : {idx0, idx1}) {
+			Tile& tile = tiles[idx];
+			// the tile does not block its neighbours anymore
+			for (int leftIdx : layout->left(idx)) tiles[leftIdx].rightCount--;
+			for (int rightIdx : layout->right(idx)) tiles[rightIdx].leftCount--;
+			for (int underIdx : layout->under(idx)) tiles[underIdx].overCount--;
+			// set current tile as removed
+			tile.isRemoved = true;
+			markChanged(idx);
+			remainingTiles--;
+			// remove current tile from related suit vector
+			int svi = tile.getSuitVectorIndex();
+			suitVectors[svi].erase(remove(suitVectors[svi].begin(), suitVectors[svi].end(), tile.tileIdx), suitVectors[svi].end());
+			// a removed tile is not open anymore
+			setOpen(idx, false);
+		}
+		// update open state of the neighbours only, they are the only tiles that can become open
+		for (int idx : {idx0, idx1}) {
+			refreshNeighbours(idx);
+		}
+	}
+
+	// reverse the edits applyRemoval made for one tile
+	void restoreTile(int idx) {
+		Tile& tile = tiles[idx];
+		for (int leftIdx : layout->left(idx)) tiles[leftIdx].rightCount++;
+		for (int rightIdx : layout->right(idx)) tiles[rightIdx].leftCount++;
+		for (int underIdx : layout->under(idx)) tiles[underIdx].overCount++;
+		tile.isRemoved = false;
+		remainingTiles++;
+		markChanged(idx);
+		suitVectors[tile.getSuitVectorIndex()].push_back(idx);
+		setOpen(idx, tile.isOpen());
+		// neighbours might have been closed by the tile coming back
+		refreshNeighbours(idx);
+	}
+
+	void refreshNeighbours(int idx) {
+		for (NeighbourRelation relation : { NEIGHBOURS_LEFT, NEIGHBOURS_RIGHT, NEIGHBOURS_UNDER }) {
+			for (int neighbourIdx : layout->neighbours(idx, relation)) {
+				if (!tiles[neighbourIdx].isRemoved) setOpen(neighbourIdx, tiles[neighbourIdx].isOpen());
+			}
+		}
+	}
+
+	// Build the deal backwards: starting from an empty board, put matching pairs on positions that
+	// would be open once placed. Removing the pairs in reverse order wins the game, so every deal
+	// produced this way is winnable. Only the positions of the tiles not removed are dealt, the
+	// others stay empty. Returns false if the positions cannot be filled, pairs placed are stored in order.
+	bool dealSolvable(const vector<int>& suits, DealRandom& rng, vector<pair<int, int>>& pairs) {
+		// group suits into pairs of tiles removable together
+		vector<vector<int>> groups(suitVectors.size());
+		for (int suit : suits) groups[suitGroups[suit]].push_back(suit);
+		vector<pair<int, int>> suitPairs;
+		for (vector<int>& group : groups) {
+			rng.shuffle(group);
+			for (int i = 0; i + 1 < (int)group.size(); i += 2) suitPairs.push_back({ group[i], group[i + 1] });
+		}
+		vector<char> placed(tiles.size());
+		vector<int> candidates;
+		// some shapes cannot be emptied two tiles at a time whatever the suits, no attempt would succeed
+		if (!canFillRemaining(placed)) return false;
+		// the remaining positions can still be left in a shape no pair fits in, in that case start again
+		for (int attempt = 0; attempt < 100; attempt++) {
+			rng.shuffle(suitPairs);
+			fill(placed.begin(), placed.end(), 0);
+			pairs.clear();
+			bool completed = true;
+			for (pair<int, int>& suitPair : suitPairs) {
+				candidates.clear();
+				for (Tile& tile : tiles) {
+					if (!tile.isRemoved && isPlaceable(tile.tileIdx, placed)) candidates.push_back(tile.tileIdx);
+				}
+				rng.shuffle(candidates);
+				int idx0, idx1;
+				if (!placePair(candidates, placed, idx0, idx1)) {
+					completed = false;
+					break;
+				}
+				tiles[idx0].suitIdx = suitPair.first;
+				tiles[idx1].suitIdx = suitPair.second;
+				pairs.push_back({ idx0, idx1 });
+			}
+			if (completed) return true;
+		}
+		return false;
+	}
+
+	// returns true if removing the pairs from the last one placed to the first clears the tiles not
+	// removed, every pair matching and open when taken
+	bool winsBackwards(const vector<pair<int, int>>& pairs) {
+		vector<char> present(tiles.size());
+		int presentCount = 0;
+		for (Tile& tile : tiles) {
+			present[tile.tileIdx] = !tile.isRemoved;
+			presentCount += !tile.isRemoved;
+		}
+		for (int i = (int)pairs.size() - 1; i >= 0; i--) {
+			int idx0 = pairs[i].first;
+			int idx1 = pairs[i].second;
+			if (idx0 == idx1 || !present[idx0] || !present[idx1] || suitGroups[tiles[idx0].suitIdx] != suitGroups[tiles[idx1].suitIdx]) return false;
+			if (!isOpenAmong(idx0, present) || !isOpenAmong(idx1, present)) return false;
+			present[idx0] = 0;
+			present[idx1] = 0;
+			presentCount -= 2;
+		}
+		return presentCount == 0;
+	}
+
+	// look for two candidates that can be placed together and mark them as placed
+	bool placePair(const vector<int>& candidates, vector<char>& placed, int& idx0, int& idx1) {
+		for (int first : candidates) {
+			placed[first] = 1;
+			// the local hole check is cheap and rules out most of the bad positions before the full one
+			if (leavesHole(first, placed) || !canFillRemaining(placed)) {
+				placed[first] = 0;
+				continue;
+			}
+			for (int second : candidates) {
+				if (second == first || !isPlaceable(second, placed)) continue;
+				placed[second] = 1;
+				if (isOpenAmong(first, placed) && !leavesHole(second, placed) && canFillRemaining(placed)) {
+					idx0 = first;
+					idx1 = second;
+					return true;
+				}
+				placed[second] = 0;
+			}
+			placed[first] = 0;
+		}
+		return false;
+	}
+
+	int countPresent(IndexRange indexes) {
+		int count = 0;
+		for (int idx : indexes) {
+			if (!tiles[idx].isRemoved) count++;
+		}
+		return count;
+	}
+
+	bool anyPlaced(IndexRange indexes, const vector<char>& placed) {
+		for (int idx : indexes) {
+			if (placed[idx]) return true;
+		}
+		return false;
+	}
+
+	// returns true if the tile would be open when placed on the board, given the tiles already placed
+	bool isOpenAmong(int idx, const vector<char>& placed) {
+		return !anyPlaced(layout->over(idx), placed) && (!anyPlaced(layout->left(idx), placed) || !anyPlaced(layout->right(idx), placed));
+	}
+
+	// a position can be filled if it is empty, all the tiles under it are there and it would be open
+	bool isPlaceable(int idx, const vector<char>& placed) {
+		if (placed[idx]) return false;
+		for (int underIdx : layout->under(idx)) {
+			if (!placed[underIdx]) return false;
+		}
+		return isOpenAmong(idx, placed);
+	}
+
+	// returns true if placing the tile encloses empty positions of its row between placed tiles,
+	// such positions could never be filled since both their sides would be taken
+	bool leavesHole(int idx, const vector<char>& placed) {
+		for (bool toLeft : { true, false }) {
+			for (int sideIdx : toLeft ? layout->left(idx) : layout->right(idx)) {
+				if (!placed[sideIdx] && !tiles[sideIdx].isRemoved && reachesPlaced(sideIdx, toLeft, placed)) return true;
+			}
+		}
+		return false;
+	}
+
+	// walk along the row from an empty position, returns true if a placed tile is met. Positions of
+	// removed tiles stay empty for good, the row is open past them
+	bool reachesPlaced(int idx, bool toLeft, const vector<char>& placed) {
+		for (int sideIdx : toLeft ? layout->left(idx) : layout->right(idx)) {
+			if (placed[sideIdx] || (!tiles[sideIdx].isRemoved && reachesPlaced(sideIdx, toLeft, placed))) return true;
+		}
+		return false;
+	}
+
+	// returns true if the empty positions can still be filled two at a time. Checked backwards:
+	// starting from a full board, empty positions are taken away in pairs of open positions, which can
+	// only make other positions open. Succeeding proves a way to complete the deal exists.
+	bool canFillRemaining(const vector<char>& placed) {
+		// scratch buffers are kept between calls, this runs several times for each pair placed
+		vector<char>& full = fillScratch;		// 0 taken away, 1 still there, 2 still there and known to be open
+		vector<int>& open = fillOpen;
+		// positions of removed tiles are not part of the deal, they are taken away from the start
+		full.resize(tiles.size());
+		for (int idx = 0; idx < (int)tiles.size(); idx++) full[idx] = !tiles[idx].isRemoved;
+		open.clear();
+		int emptyCount = 0;
+		for (int idx = 0; idx < (int)tiles.size(); idx++) {
+			if (!placed[idx] && full[idx]) emptyCount++;
+		}
+		for (int idx = 0; idx < (int)tiles.size(); idx++) {
+			if (!placed[idx] && full[idx] && isOpenAmong(idx, full)) {
+				full[idx] = 2;
+				open.push_back(idx);
+			}
+		}
+		while (emptyCount > 0) {
+			// with an odd number of empty positions (half a pair placed) one of them can be taken alone
+			int takenCount = (open.size() == 1 && emptyCount % 2 == 1) ? 1 : 2;
+			if ((int)open.size() < takenCount) return false;
+			int takenPair[2] = { open.back(), open.size() > 1 ? open[open.size() - 2] : open.back() };
+			open.resize(open.size() - takenCount);
+			for (int i = 0; i < takenCount; i++) full[takenPair[i]] = 0;
+			emptyCount -= takenCount;
+			// only the neighbours of the positions taken away can have become open
+			for (int i = 0; i < takenCount; i++) {
+				for (NeighbourRelation relation : { NEIGHBOURS_LEFT, NEIGHBOURS_RIGHT, NEIGHBOURS_UNDER }) {
+					for (int neighbourIdx : layout->neighbours(takenPair[i], relation)) {
+						if (!placed[neighbourIdx] && full[neighbourIdx] == 1 && isOpenAmong(neighbourIdx, full)) {
+							full[neighbourIdx] = 2;
+							open.push_back(neighbourIdx);
+						}
+					}
+				}
+			}
 		}
 		return true;
 	}
 
+	// compute open state of all the tiles from scratch, only needed when a game is dealt or restored
+	void initOpenTiles() {
+		openFlags.assign(tiles.size(), false);
+		for (vector<int>& openVector : openVectors) openVector.clear();
+		movableGroups = 0;
+		remainingTiles = 0;
+		for (Tile& tile : tiles) {
+			if (tile.isRemoved) continue;
+			remainingTiles++;
+			setOpen(tile.tileIdx, tile.isOpen());
+		}
+	}
+
+	// keep open vectors and counter of movable groups consistent with the open state of a tile
+	void setOpen(int idx, bool open) {
+		if (openFlags[idx] == open) return;
+		openFlags[idx] = open;
+		vector<int>& openVector = openVectors[tiles[idx].getSuitVectorIndex()];
+		bool wasMovable = openVector.size() > 1;
+		if (open) openVector.push_back(idx);
+		else openVector.erase(remove(openVector.begin(), openVector.end(), idx), openVector.end());
+		bool isMovable = openVector.size() > 1;
+		movableGroups += (int)isMovable - (int)wasMovable;
+	}
+
 };
\ No newline at end of file
@@ -0,0 +1,318 @@
+#pragma once
+#include "Tile.hpp"
+#include "LayoutBuilder.hpp"
+#include "MappedFile.hpp"
+#include <glm/glm.hpp>
+#include <json.hpp>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+using namespace std;
+
+// Header of a compiled layout file. Sections follow the header, every offset is in bytes from the
+// beginning of the file and multiple of 4, all the values are little endian.
+struct LayoutFileHeader {
+	char magic[4];					// "MJLY"
+	uint32_t version;
+	uint32_t fileSize;
+	uint32_t tileCount;
+	uint32_t groupCount;			// Number of groups of suits removable together
+	uint32_t positionsOffset;		// float[3 * tileCount], x y z of each tile
+	uint32_t groupStartsOffset;		// uint32[groupCount + 1], start of each group in the group suits
+	uint32_t groupSuitsOffset;		// int32[tileCount], suits dealt over the tiles, sorted by group
+	uint32_t neighbourStartsOffset;	// uint32[tileCount * NEIGHBOUR_RELATIONS + 1], start of each list in the neighbour indexes
+	uint32_t neighbourIndexesOffset;// int32[], lists of a tile are contiguous, in NeighbourRelation order
+};
+
+const char LAYOUT_MAGIC[4] = { 'M', 'J', 'L', 'Y' };
+const uint32_t LAYOUT_VERSION = 1;
+
+// Tile indexes are packed on 16 bits in the undo stack and in the hint engine, which keeps 0xFFFF for
+// "no tile", and suits share the tile records of the renderer with the flags above their low 16 bits
+const uint32_t LAYOUT_MAX_TILES = 0xFFFF;
+const int32_t LAYOUT_MAX_SUIT = 0xFFFF;
+
+// Contiguous run of indexes inside a layout, can be walked with a range-based for
+struct IndexRange {
+	const int32_t* first;
+	const int32_t* last;
+
+	const int32_t* begin() const { return first; }
+	const int32_t* end() const { return last; }
+	int size() const { return (int)(last - first); }
+	bool empty() const { return first == last; }
+};
+
+// Geometry and adjacency of a board, never modified once loaded.
+// The data is read in place from a memory-mapped compiled layout file, so opening a layout costs
+// a few system calls no matter how many tiles it has. A structure.json can be opened as well: it is
+// compiled once into a .mjl file next to it, which is mapped from then on.
+class MahjongLayout {
+
+public:
+	// opens a compiled layout, or a json structure through its compiled copy
+	static shared_ptr<const MahjongLayout> open(const string& path) {
+		filesystem::path source(path);
+		if (source.extension() != ".json") {
+			return shared_ptr<const MahjongLayout>(new MahjongLayout(path));
+		}
+		filesystem::path compiled = filesystem::path(source).replace_extension(".mjl");
+		error_code error;
+		bool upToDate = filesystem::exists(compiled, error) &&
+			filesystem::last_write_time(compiled, error) >= filesystem::last_write_time(source, error) && !error;
+		if (!upToDate) {
+			vector<uint8_t> image = compileImage(path);
+			// the folder might not be writable, in that case the layout is used straight from memory
+			if (!MappedFile::writeAtomically(image, compiled.string())) {
+				return shared_ptr<const MahjongLayout>(new MahjongLayout(move(image)));
+			}
+		}
+		return shared_ptr<const MahjongLayout>(new MahjongLayout(compiled.string()));
+	}
+
+	// turns a json structure into a compiled layout file
+	static void compile(const string& jsonPath, const string& binaryPath) {
+		if (!MappedFile::writeAtomically(compileImage(jsonPath), binaryPath)) {
+			throw runtime_error("Unable to write compiled layout " + binaryPath);
+		}
+	}
+
+	// layout built in memory, e.g. by LayoutBuilder, never written to disk
+	static shared_ptr<const MahjongLayout> build(const LayoutSource& source) {
+		return shared_ptr<const MahjongLayout>(new MahjongLayout(compileImage(source, "in memory")));
+	}
+
+	static void compile(const LayoutSource& source, const string& binaryPath) {
+		if (!MappedFile::writeAtomically(compileImage(source, binaryPath), binaryPath)) {
+			throw runtime_error("Unable to write compiled layout " + binaryPath);
+		}
+	}
+
+	// reads a json structure. When the structure gives the size of its tiles ("tileSize": [tx, ty, tz])
+	// neighbours are computed from the positions, lists written in the file must then agree with them
+	static LayoutSource readSource(const string& jsonPath) {
+		ifstream f(jsonPath);
+		if (!f) throw runtime_error("Unable to open structure " + jsonPath);
+		json data = json::parse(f);
+		f.close();
+		LayoutSource source;
+		int tileCount = (int)data["tiles"].size();
+		for (const json& el : data["suits"]) source.suits.push_back(el);
+		if (data.contains("groups")) {
+			for (const json& group : data["groups"]) source.groups.push_back(group.get<vector<int>>());
+		}
+		// tiles are stored by index, whatever their order in the file
+		vector<const json*> tiles(tileCount, nullptr);
+		for (const json& tile : data["tiles"]) {
+			int tileIdx = tile["tileIdx"];
+			if (tileIdx < 0 || tileIdx >= tileCount || tiles[tileIdx]) throw runtime_error("Structure " + jsonPath + " has a bad tile index " + to_string(tileIdx));
+			tiles[tileIdx] = &tile;
+		}
+		const char* relationNames[NEIGHBOUR_RELATIONS] = { "over", "under", "left", "right" };
+		bool hasLists = false;
+		for (const json* tile : tiles) {
+			vector<float> coords = (*tile)["position"].get<vector<float>>();
+			if (coords.size() != 3) throw runtime_error("Structure " + jsonPath + " has tiles without a 3D position");
+			source.positions.push_back(glm::vec3(coords[0], coords[1], coords[2]));
+			for (const char* relationName : relationNames) {
+				hasLists = hasLists || tile->contains(relationName);
+				source.neighbours.push_back(tile->contains(relationName) ? (*tile)[relationName].get<vector<int>>() : vector<int>());
+			}
+		}
+		if (data.contains("tileSize")) {
+			vector<float> size = data["tileSize"].get<vector<float>>();
+			if (size.size() != 3) throw runtime_error("Structure " + jsonPath + " has a bad tile size");
+			LayoutSource written = source;
+			LayoutBuilder::inferNeighbours(source, { size[0], size[1], size[2] });
+			string difference = hasLists ? LayoutBuilder::compareNeighbours(written, source) : "";
+			if (!difference.empty()) throw runtime_error("Structure " + jsonPath + ": " + difference);
+		}
+		return source;
+	}
+
+	MahjongLayout(const MahjongLayout&) = delete;
+	MahjongLayout& operator=(const MahjongLayout&) = delete;
+
+	int tileCount() const {
+		return (int)header().tileCount;
+	}
+
+	glm::vec3 position(int idx) const {
+		const float* coords = section<float>(header().positionsOffset) + 3 * idx;
+		return glm::vec3(coords[0], coords[1], coords[2]);
+	}
+
+	int groupCount() const {
+		return (int)header().groupCount;
+	}
+
+	// suits of the given group, every tile gets one of the suits of the layout when a game is dealt
+	IndexRange groupSuits(int group) const {
+		const uint32_t* starts = section<uint32_t>(header().groupStartsOffset);
+		const int32_t* suits = section<int32_t>(header().groupSuitsOffset);
+		return { suits + starts[group], suits + starts[group + 1] };
+	}
+
+	// all the suits of the layout, one per tile
+	IndexRange suits() const {
+		const int32_t* suits = section<int32_t>(header().groupSuitsOffset);
+		return { suits, suits + tileCount() };
+	}
+
+	IndexRange neighbours(int idx, NeighbourRelation relation) const {
+		const uint32_t* starts = section<uint32_t>(header().neighbourStartsOffset);
+		const int32_t* indexes = section<int32_t>(header().neighbourIndexesOffset);
+		int row = idx * NEIGHBOUR_RELATIONS + relation;
+		return { indexes + starts[row], indexes + starts[row + 1] };
+	}
+
+	IndexRange over(int idx) const { return neighbours(idx, NEIGHBOURS_OVER); }
+	IndexRange under(int idx) const { return neighbours(idx, NEIGHBOURS_UNDER); }
+	IndexRange left(int idx) const { return neighbours(idx, NEIGHBOURS_LEFT); }
+	IndexRange right(int idx) const { return neighbours(idx, NEIGHBOURS_RIGHT); }
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	unique_ptr<MappedFile> file;	// Set when data is a view of a file, otherwise data points into image
+	vector<uint8_t> image;
+
+	// maps a compiled layout file in memory, read only
+	MahjongLayout(const string& path) {
+		file = make_unique<MappedFile>(path, "layout");
+		data = file->begin();
+		size = file->bytes();
+		validate(path);
+	}
+
+	MahjongLayout(vector<uint8_t>&& image) {
+		this->image = move(image);
+		data = this->image.data();
+		size = this->image.size();
+		validate("in memory");
+	}
+
+	const LayoutFileHeader& header() const {
+		return *(const LayoutFileHeader*)data;
+	}
+
+	template <class T>
+	const T* section(uint32_t offset) const {
+		return (const T*)(data + offset);
+	}
+
+	// checks the file before any access, a corrupted layout must not make the game read out of bounds
+	void validate(const string& name) const {
+		auto fail = [&](const string& reason) {
+			throw runtime_error("Invalid layout " + name + ": " + reason);
+		};
+		if (size < sizeof(LayoutFileHeader)) fail("file too short");
+		const LayoutFileHeader& h = header();
+		if (memcmp(h.magic, LAYOUT_MAGIC, 4) != 0) fail("not a compiled layout");
+		if (h.version != LAYOUT_VERSION) fail("unsupported version " + to_string(h.version));
+		if (h.fileSize != size) fail("truncated file");
+		uint64_t tiles = h.tileCount;
+		if (tiles > LAYOUT_MAX_TILES) fail("more than " + to_string(LAYOUT_MAX_TILES) + " tiles");
+		uint64_t rows = tiles * NEIGHBOUR_RELATIONS;
+		auto checkSection = [&](uint32_t offset, uint64_t bytes) {
+			if (offset % 4 != 0 || offset < sizeof(LayoutFileHeader) || offset + bytes > size) fail("section out of bounds");
+		};
+		checkSection(h.positionsOffset, tiles * 3 * sizeof(float));
+		checkSection(h.groupStartsOffset, (h.groupCount + 1ULL) * sizeof(uint32_t));
+		checkSection(h.groupSuitsOffset, tiles * sizeof(int32_t));
+		checkSection(h.neighbourStartsOffset, (rows + 1) * sizeof(uint32_t));
+		const uint32_t* groupStarts = section<uint32_t>(h.groupStartsOffset);
+		if (groupStarts[0] != 0 || groupStarts[h.groupCount] != tiles) fail("bad suit groups");
+		for (uint32_t g = 0; g < h.groupCount; g++) {
+			// tiles are removed in pairs, a group with an odd number of suits could never be cleared
+			if (groupStarts[g] > groupStarts[g + 1] || (groupStarts[g + 1] - groupStarts[g]) % 2 != 0) fail("bad suit groups");
+		}
+		const int32_t* groupSuits = section<int32_t>(h.groupSuitsOffset);
+		for (uint32_t i = 0; i < tiles; i++) {
+			if (groupSuits[i] < 0) fail("negative suit");
+			if (groupSuits[i] > LAYOUT_MAX_SUIT) fail("suit out of range");
+		}
+		const uint32_t* starts = section<uint32_t>(h.neighbourStartsOffset);
+		if (starts[0] != 0) fail("bad neighbour lists");
+		for (uint64_t row = 0; row < rows; row++) {
+			if (starts[row] > starts[row + 1]) fail("bad neighbour lists");
+		}
+		checkSection(h.neighbourIndexesOffset, starts[rows] * sizeof(int32_t));
+		const int32_t* indexes = section<int32_t>(h.neighbourIndexesOffset);
+		for (uint32_t i = 0; i < starts[rows]; i++) {
+			if (indexes[i] < 0 || indexes[i] >= (int64_t)tiles) fail("neighbour index out of range");
+		}
+	}
+
+	// builds the compiled image of a json structure
+	static vector<uint8_t> compileImage(const string& jsonPath) {
+		return compileImage(readSource(jsonPath), jsonPath);
+	}
+
+	static vector<uint8_t> compileImage(const LayoutSource& source, const string& name) {
+		int tileCount = (int)source.positions.size();
+		if ((int)source.suits.size() != tileCount) {
+			throw runtime_error("Structure " + name + " has " + to_string(source.suits.size()) + " suits for " + to_string(tileCount) + " tiles");
+		}
+		vector<float> positions;
+		for (const glm::vec3& position : source.positions) positions.insert(positions.end(), { position.x, position.y, position.z });
+		vector<uint32_t> neighbourStarts = { 0 };
+		vector<int32_t> neighbourIndexes;
+		for (const vector<int>& list : source.neighbours) {
+			neighbourIndexes.insert(neighbourIndexes.end(), list.begin(), list.end());
+			neighbourStarts.push_back((uint32_t)neighbourIndexes.size());
+		}
+		if (neighbourStarts.size() != (size_t)tileCount * NEIGHBOUR_RELATIONS + 1) throw runtime_error("Structure " + name + " has incomplete neighbour lists");
+		// group the suits, each group lists the suits that can be removed together. Structures can list
+		// their own groups as arrays of suits, otherwise the rules of the standard set apply
+		vector<vector<int32_t>> groups;
+		map<int, int> customGroups;
+		for (int group = 0; group < (int)source.groups.size(); group++) {
+			for (int suit : source.groups[group]) customGroups[suit] = group;
+		}
+		for (int suit : source.suits) {
+			if (suit < 0) throw runtime_error("Structure " + name + " has a negative suit");
+			if (!customGroups.empty() && !customGroups.count(suit)) throw runtime_error("Structure " + name + " has suit " + to_string(suit) + " in no group");
+			int group = customGroups.empty() ? Tile::suitVectorIndexOf(suit) : customGroups[suit];
+			if (group >= (int)groups.size()) groups.resize(group + 1);
+			groups[group].push_back(suit);
+		}
+		vector<uint32_t> groupStarts = { 0 };
+		vector<int32_t> groupSuits;
+		for (vector<int32_t>& group : groups) {
+			if (group.size() % 2 != 0) throw runtime_error("Structure " + name + " has a group of suits with an odd number of tiles");
+			groupSuits.insert(groupSuits.end(), group.begin(), group.end());
+			groupStarts.push_back((uint32_t)groupSuits.size());
+		}
+
+		LayoutFileHeader h = {};
+		memcpy(h.magic, LAYOUT_MAGIC, 4);
+		h.version = LAYOUT_VERSION;
+		h.tileCount = tileCount;
+		h.groupCount = (uint32_t)groups.size();
+		vector<uint8_t> image(sizeof(LayoutFileHeader));
+		auto append = [&](const auto& values) {
+			uint32_t offset = (uint32_t)image.size();
+			size_t bytes = values.size() * sizeof(values[0]);
+			image.resize(image.size() + bytes);
+			if (bytes > 0) memcpy(image.data() + offset, values.data(), bytes);
+			return offset;
+		};
+		h.positionsOffset = append(positions);
+		h.groupStartsOffset = append(groupStarts);
+		h.groupSuitsOffset = append(groupSuits);
+		h.neighbourStartsOffset = append(neighbourStarts);
+		h.neighbourIndexesOffset = append(neighbourIndexes);
+		h.fileSize = (uint32_t)image.size();
+		memcpy(image.data(), &h, sizeof(h));
+		return image;
+	}
+};
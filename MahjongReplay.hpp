@@ -0,0 +1,154 @@
+#pragma once
+#include "MahjongGame.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Recording of a game: the seed of the deal, the pairs removed and the reshuffles, enough to rebuild
+// every state.
+// File layout: "MJRP", then varints (LEB128, 7 bits per byte, low bits first) for the format version,
+// the 64-bit seed, the deal mode, the tile count of the layout, the number of moves and both tiles of
+// every move, then the number of reshuffles and for each one the moves made before it and its seed.
+// Version 1 files end after the moves. Tile indexes below 128 take a single byte, so a whole game of
+// 144 tiles fits in ~150 bytes.
+class MahjongReplay {
+
+public:
+	uint64_t seed = 0;
+	DealMode dealMode = DEAL_RANDOM;
+	int tileCount = 0;					// Tiles of the layout the game was played on
+	vector<pair<int, int>> moves;		// Pairs removed, in order
+	vector<MahjongGame::Reshuffle> reshuffles;	// Reshuffles, in order
+
+	// records the current state of a game, moves undone are not part of it
+	static MahjongReplay record(const MahjongGame& game) {
+		MahjongReplay replay;
+		replay.seed = game.seed;
+		replay.dealMode = game.dealMode;
+		replay.tileCount = (int)game.tiles.size();
+		replay.moves = game.getMoves();
+		replay.reshuffles = game.getReshuffles();
+		return replay;
+	}
+
+	vector<uint8_t> encode() const {
+		vector<uint8_t> bytes(MAGIC, MAGIC + 4);
+		writeVarint(bytes, VERSION);
+		writeVarint(bytes, seed);
+		writeVarint(bytes, dealMode);
+		writeVarint(bytes, tileCount);
+		writeVarint(bytes, moves.size());
+		for (const pair<int, int>& move : moves) {
+			writeVarint(bytes, move.first);
+			writeVarint(bytes, move.second);
+		}
+		writeVarint(bytes, reshuffles.size());
+		for (const MahjongGame::Reshuffle& reshuffle : reshuffles) {
+			writeVarint(bytes, reshuffle.moveCount);
+			writeVarint(bytes, reshuffle.seed);
+		}
+		return bytes;
+	}
+
+	static MahjongReplay decode(const vector<uint8_t>& bytes) {
+		if (bytes.size() < 4 || !equal(MAGIC, MAGIC + 4, bytes.begin())) throw runtime_error("Not a replay");
+		size_t pos = 4;
+		uint64_t version = readVarint(bytes, pos);
+		if (version < 1 || version > VERSION) throw runtime_error("Unsupported replay version");
+		MahjongReplay replay;
+		replay.seed = readVarint(bytes, pos);
+		uint64_t dealMode = readVarint(bytes, pos);
+		if (dealMode > DEAL_SOLVABLE) throw runtime_error("Corrupted replay");
+		replay.dealMode = (DealMode)dealMode;
+		replay.tileCount = (int)readVarint(bytes, pos);
+		uint64_t moveCount = readVarint(bytes, pos);
+		// every move takes at least two bytes, a larger count can only come from a corrupted file
+		if (moveCount > (bytes.size() - pos) / 2) throw runtime_error("Truncated replay");
+		replay.moves.resize(moveCount);
+		for (pair<int, int>& move : replay.moves) {
+			move.first = (int)readVarint(bytes, pos);
+			move.second = (int)readVarint(bytes, pos);
+		}
+		if (version >= 2) {
+			uint64_t reshuffleCount = readVarint(bytes, pos);
+			if (reshuffleCount > (bytes.size() - pos) / 2) throw runtime_error("Truncated replay");
+			replay.reshuffles.resize(reshuffleCount);
+			int previousCount = 0;
+			for (MahjongGame::Reshuffle& reshuffle : replay.reshuffles) {
+				uint64_t moveCount = readVarint(bytes, pos);
+				// reshuffles come in order and no later than the last move
+				if (moveCount < (uint64_t)previousCount || moveCount > replay.moves.size()) throw runtime_error("Corrupted replay");
+				reshuffle.moveCount = previousCount = (int)moveCount;
+				reshuffle.seed = readVarint(bytes, pos);
+			}
+		}
+		return replay;
+	}
+
+	void save(const string& path) const {
+		vector<uint8_t> bytes = encode();
+		ofstream out(path, ios::binary | ios::trunc);
+		out.write((const char*)bytes.data(), bytes.size());
+		if (!out) throw runtime_error("Unable to write replay " + path);
+	}
+
+	static MahjongReplay load(const string& path) {
+		ifstream in(path, ios::binary);
+		if (!in) throw runtime_error("Unable to open replay " + path);
+		vector<uint8_t> bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		return decode(bytes);
+	}
+
+	// moves and reshuffles of the game
+	int stepCount() const {
+		return (int)(moves.size() + reshuffles.size());
+	}
+
+	// deals the recorded game and plays all its moves and reshuffles in order, returns the number of
+	// them played before the first one that is not legal anymore or a reshuffle that fails, which
+	// equals stepCount() when the replay still holds
+	int play(MahjongGame& game) const {
+		if ((int)game.tiles.size() != tileCount) throw runtime_error("Replay recorded on a layout of " + to_string(tileCount) + " tiles");
+		game.newGame(dealMode, seed);
+		size_t nextReshuffle = 0;
+		for (int i = 0; i <= (int)moves.size(); i++) {
+			for (; nextReshuffle < reshuffles.size() && reshuffles[nextReshuffle].moveCount == i; nextReshuffle++) {
+				if (!game.reshuffle(reshuffles[nextReshuffle].seed)) return i + (int)nextReshuffle;
+			}
+			if (i == (int)moves.size()) break;
+			const pair<int, int>& move = moves[i];
+			if (move.first < 0 || move.second < 0 || move.first >= tileCount || move.second >= tileCount || !game.canRemoveTiles(move.first, move.second)) return i + (int)nextReshuffle;
+			game.removeTiles(move.first, move.second);
+		}
+		return stepCount();
+	}
+
+private:
+	static constexpr uint8_t MAGIC[4] = { 'M', 'J', 'R', 'P' };
+	static const uint64_t VERSION = 2;
+
+	static void writeVarint(vector<uint8_t>& bytes, uint64_t value) {
+		while (value >= 0x80) {
+			bytes.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		bytes.push_back((uint8_t)value);
+	}
+
+	static uint64_t readVarint(const vector<uint8_t>& bytes, size_t& pos) {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (pos >= bytes.size()) throw runtime_error("Truncated replay");
+			uint8_t byte = bytes[pos++];
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) return value;
+		}
+		throw runtime_error("Corrupted replay");
+	}
+};
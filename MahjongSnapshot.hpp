@@ -0,0 +1,88 @@
+#pragma once
+#include "MahjongGame.hpp"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+// State of the app around the board, saved together with it
+struct SessionState {
+	int gameState = 0;
+	int firstTileIndex = -1;		// Tiles selected by the player, -1 if none
+	int secondTileIndex = -1;
+};
+
+// Binary snapshot of a game in progress, restored without parsing nor replaying any move.
+// Blob layout: a fixed header, the suit of every tile on 16 bits, then one bit per tile set if the
+// tile has been removed. Values are stored in the byte order of the machine: snapshots are meant
+// to checkpoint and fork games, not to be exchanged (replays are portable). 338 bytes for 144 tiles.
+class MahjongSnapshot {
+
+public:
+	// writes the snapshot into blob, reusing its storage
+	static void save(const MahjongGame& game, const SessionState& session, vector<uint8_t>& blob) {
+		int tileCount = (int)game.tiles.size();
+		Header header;
+		memcpy(header.magic, MAGIC, 4);
+		header.tileCount = tileCount;
+		header.seed = game.seed;
+		header.dealMode = game.dealMode;
+		header.gameState = session.gameState;
+		header.firstTileIndex = session.firstTileIndex;
+		header.secondTileIndex = session.secondTileIndex;
+		blob.assign(sizeOf(tileCount), 0);
+		memcpy(blob.data(), &header, sizeof(Header));
+		uint16_t* suits = (uint16_t*)(blob.data() + sizeof(Header));
+		uint8_t* removed = (uint8_t*)(suits + tileCount);
+		for (const Tile& tile : game.tiles) {
+			suits[tile.tileIdx] = (uint16_t)tile.suitIdx;
+			if (tile.isRemoved) removed[tile.tileIdx >> 3] |= 1 << (tile.tileIdx & 7);
+		}
+	}
+
+	// puts the game back in the saved state, returns the state of the app. Throws, leaving the game
+	// untouched, if the board could not come from a deal of the layout
+	static SessionState restore(MahjongGame& game, const vector<uint8_t>& blob) {
+		int tileCount = (int)game.tiles.size();
+		Header header;
+		if (blob.size() < sizeof(Header)) throw runtime_error("Not a snapshot");
+		memcpy(&header, blob.data(), sizeof(Header));
+		if (memcmp(header.magic, MAGIC, 4) != 0) throw runtime_error("Not a snapshot");
+		if (header.tileCount != tileCount || blob.size() != sizeOf(tileCount)) throw runtime_error("Snapshot taken on a different layout");
+		const uint8_t* suits = blob.data() + sizeof(Header);
+		const uint8_t* removed = suits + 2 * tileCount;
+		game.restoreBoard(
+			[&](int idx) {
+				uint16_t suit;
+				memcpy(&suit, suits + 2 * idx, 2);
+				return (int)suit;
+			},
+			[&](int idx) { return ((removed[idx >> 3] >> (idx & 7)) & 1) != 0; });
+		game.seed = header.seed;
+		game.dealMode = (DealMode)header.dealMode;
+		SessionState session;
+		session.gameState = header.gameState;
+		session.firstTileIndex = header.firstTileIndex;
+		session.secondTileIndex = header.secondTileIndex;
+		return session;
+	}
+
+private:
+	struct Header {
+		char magic[4];
+		int32_t tileCount;
+		uint64_t seed;				// Seed of the deal the game comes from
+		int32_t dealMode;
+		int32_t gameState;
+		int32_t firstTileIndex;
+		int32_t secondTileIndex;
+	};
+
+	static constexpr char MAGIC[4] = { 'M', 'J', 'S', 'S' };
+
+	static size_t sizeOf(int tileCount) {
+		return sizeof(Header) + 2 * (size_t)tileCount + (tileCount + 7) / 8;
+	}
+};
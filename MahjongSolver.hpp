@@ -0,0 +1,191 @@
+#pragma once
+#include "DeadlockAnalyzer.hpp"
+#include "EndgameTable.hpp"
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+// Bounded hash table remembering the positions already proven unwinnable.
+// Each bucket has two slots: the first keeps the position with more tiles left (most expensive
+// to search again), the second is always replaced, so memory never grows past the initial size.
+class TranspositionTable {
+
+public:
+	TranspositionTable(size_t maxBytes) {
+		size_t bucketCount = 1;
+		while (bucketCount * 2 * sizeof(Bucket) <= maxBytes) bucketCount *= 2;
+		buckets.resize(bucketCount);
+		mask = bucketCount - 1;
+	}
+
+	// entries written before the last call are ignored from now on, no memory is touched
+	void clear() {
+		generation++;
+	}
+
+	bool contains(uint64_t key) const {
+		const Bucket& bucket = buckets[key & mask];
+		for (const Entry& entry : bucket.slots) {
+			if (entry.key == key && entry.generation == generation) return true;
+		}
+		return false;
+	}
+
+	void store(uint64_t key, int tilesLeft) {
+		Bucket& bucket = buckets[key & mask];
+		Entry& preferred = bucket.slots[0];
+		Entry newEntry = { key, generation, (uint16_t)tilesLeft };
+		if (preferred.generation != generation || preferred.tilesLeft <= tilesLeft) {
+			// keep the entry that was pushed out if it is still worth more than the always-replace one
+			if (preferred.generation == generation) bucket.slots[1] = preferred;
+			preferred = newEntry;
+		}
+		else {
+			bucket.slots[1] = newEntry;
+		}
+	}
+
+	size_t sizeInBytes() const {
+		return buckets.size() * sizeof(Bucket);
+	}
+
+private:
+	struct Entry {
+		uint64_t key = 0;
+		uint32_t generation = 0;
+		uint16_t tilesLeft = 0;
+	};
+
+	struct Bucket {
+		Entry slots[2];
+	};
+
+	vector<Bucket> buckets;
+	size_t mask = 0;
+	uint32_t generation = 1;
+};
+
+// Exact solver deciding whether a deal can still be won from its current state.
+// Depth-first search on a MahjongBitboard with make/unmake of pairs, the removed-tile set is
+// hashed incrementally with Zobrist keys and losing positions are cached in the transposition table.
+// Positions the DeadlockAnalyzer proves lost are cut without expanding their moves.
+// Tiles of a class are interchangeable once all of them are open: whatever the order and the pairing,
+// removing them ends in the same position, so such a class is cleared at once as the only move tried.
+class MahjongSolver {
+
+public:
+	vector<pair<int, int>> solution;	// Winning sequence of pairs found by the last solve
+	long long nodes = 0;				// Positions expanded by the last solve
+	long long deadlocks = 0;			// Positions cut by the deadlock analyzer during the last solve
+	long long nodeLimit;				// Search budget, 0 means unlimited
+	function<bool()> stopCondition;		// Polled every few thousand nodes, returning true aborts the search
+	shared_ptr<const EndgameTable> endgames;	// Optional tablebase of the deal, ignored for boards of other deals
+
+	MahjongSolver(size_t tableBytes = 64 << 20, long long nodeLimit = 0) : table(tableBytes) {
+		this->nodeLimit = nodeLimit;
+		// fixed seed: keys only need to be well distributed, not secret
+		mt19937_64 rng(0x6d61686a6f6e67);
+		for (uint64_t& key : zobristKeys) key = rng();
+	}
+
+	SolverResult solve(const MahjongGame& game) {
+		return solve(MahjongBitboard(game));
+	}
+
+	// searches for a winning sequence from the current state of the board
+	// sameDeal keeps the positions proven lost by the previous solve, only valid when both boards come
+	// from the same deal (layout and suits), e.g. to solve every move of a position in turn
+	SolverResult solve(const MahjongBitboard& start, bool sameDeal = false) {
+		MahjongBitboard board = start;
+		solution.clear();
+		nodes = 0;
+		deadlocks = 0;
+		aborted = false;
+		useEndgames = endgames && endgames->matches(start);
+		if (!sameDeal || !analyzer) {
+			// built from the layout of the board, a few microseconds against the search
+			analyzer = make_unique<DeadlockAnalyzer>(start);
+			// positions from a previous deal must not be reused, suits might be different
+			table.clear();
+		}
+		uint64_t hash = 0;
+		for (int idx = 0; idx < board.tileCount; idx++) {
+			if (!board.present.test(idx)) hash ^= zobristKeys[idx];
+		}
+		if (search(board, hash, true)) return SOLVER_SOLVABLE;
+		solution.clear();
+		return aborted ? SOLVER_UNKNOWN : SOLVER_UNSOLVABLE;
+	}
+
+private:
+	TranspositionTable table;
+	uint64_t zobristKeys[MAHJONG_MAX_TILES];
+	bool aborted = false;
+	bool useEndgames = false;
+	unique_ptr<DeadlockAnalyzer> analyzer;
+
+	// checkDeadlock is set when the last pair removed might have created a deadlock
+	bool search(MahjongBitboard& board, uint64_t hash, bool checkDeadlock) {
+		if (board.isWon()) return true;
+		if ((nodeLimit > 0 && nodes >= nodeLimit) || (stopCondition && (nodes & 4095) == 0 && stopCondition())) {
+			aborted = true;
+			return false;
+		}
+		nodes++;
+		if (table.contains(hash)) return false;
+		// small positions are answered by the tablebase, the rest of the line comes from it too
+		if (useEndgames && board.present.count() <= endgames->maxTiles()) {
+			if (endgames->probe(board.present) != SOLVER_SOLVABLE) return false;
+			endgames->winningLine(board, solution);
+			return true;
+		}
+		if (checkDeadlock && analyzer->isDeadlocked(board)) {
+			deadlocks++;
+			table.store(hash, board.present.count());
+			return false;
+		}
+
+		// a class with all its tiles open is safe to clear right away: removing tiles never closes any
+		// other tile, so any winning line still works with these pairs moved to the front; a class with an
+		// odd count (only from a malformed board) can never be cleared and is left to the normal search
+		TileSet open = board.openTiles();
+		for (const TileSet& classMask : board.classMasks) {
+			TileSet safe = board.present & classMask;
+			if (safe.none() || (safe - open).any() || safe.count() % 2 != 0) continue;
+			size_t solutionSize = solution.size();
+			uint64_t childHash = hash;
+			for (TileSet left = safe; left.any();) {
+				int idx0 = left.first();
+				left.reset(idx0);
+				int idx1 = left.first();
+				left.reset(idx1);
+				solution.push_back({ idx0, idx1 });
+				childHash ^= zobristKeys[idx0] ^ zobristKeys[idx1];
+			}
+			board.present = board.present - safe;
+			// the class is gone and the others only lost blockers, no new deadlock can appear
+			if (search(board, childHash, false)) return true;
+			board.present = board.present | safe;
+			solution.resize(solutionSize);
+			if (!aborted) table.store(hash, board.present.count());
+			return false;
+		}
+
+		bool stopped = board.forEachLegalPair(open, [&](int idx0, int idx1) {
+			board.present.reset(idx0);
+			board.present.reset(idx1);
+			solution.push_back({ idx0, idx1 });
+			// removing tiles only loosens the order between pairs, a new deadlock needs new forced pairs,
+			// which only appear in the class of the pair when two or four of its tiles are left
+			int classLeft = (board.present & board.classMasks[board.matchClass[idx0]]).count();
+			if (search(board, hash ^ zobristKeys[idx0] ^ zobristKeys[idx1], classLeft == 2 || classLeft == 4)) return true;
+			solution.pop_back();
+			board.restoreTiles(idx0, idx1);
+			return aborted;
+		});
+		if (stopped) return !aborted;
+		table.store(hash, board.present.count());
+		return false;
+	}
+};
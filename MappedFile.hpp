@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Whole file mapped in memory, read only, for the binary formats used in place without parsing.
+// The view is released with the object.
+class MappedFile {
+
+public:
+	// kind names the content of the file in error messages, e.g. "layout"
+	MappedFile(const string& path, const string& kind) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) throw runtime_error("Unable to open " + kind + " " + path);
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+		size = (size_t)fileSize.QuadPart;
+		HANDLE mapping = size > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+		// the view keeps the mapping alive, handles are not needed anymore
+		CloseHandle(file);
+		if (mapping == NULL) throw runtime_error("Unable to map " + kind + " " + path);
+		data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (data == nullptr) throw runtime_error("Unable to map " + kind + " " + path);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) throw runtime_error("Unable to open " + kind + " " + path);
+		struct stat fileStat;
+		fstat(fd, &fileStat);
+		size = (size_t)fileStat.st_size;
+		void* view = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		// the mapping stays valid after the descriptor is closed
+		close(fd);
+		if (view == MAP_FAILED) throw runtime_error("Unable to map " + kind + " " + path);
+		data = (const uint8_t*)view;
+#endif
+	}
+
+	~MappedFile() {
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap((void*)data, size);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* begin() const { return data; }
+	size_t bytes() const { return size; }
+
+	// the image is written aside and then renamed, so that a concurrent open never maps a partial file
+	static bool writeAtomically(const vector<uint8_t>& image, const string& path) {
+		string temporaryPath = path + "." + to_string(hash<thread::id>()(this_thread::get_id())) + ".tmp";
+		ofstream out(temporaryPath, ios::binary | ios::trunc);
+		if (!out) return false;
+		out.write((const char*)image.data(), image.size());
+		out.close();
+		error_code error;
+		if (!out.fail()) filesystem::rename(temporaryPath, path, error);
+		if (out.fail() || error) {
+			filesystem::remove(temporaryPath, error);
+			// renaming fails on Windows while the file is mapped: someone else has just written it
+			return !out.fail() && filesystem::exists(path, error);
+		}
+		return true;
+	}
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include "MahjongBitboard.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <cmath>
+
+using namespace std;
+
+// Result of a batch of playouts, the interval is the Wilson score interval for the given z
+struct WinEstimate {
+	long long playouts = 0;
+	long long wins = 0;
+	double probability = 0.0;
+	double lower = 0.0;
+	double upper = 0.0;
+};
+
+// Estimates the probability of winning a game from its current state by playing random
+// pairs until the board is cleared or no move is left. Playouts run on a thread pool, every worker
+// owns an RNG stream and a scratch bitboard: a playout only resets the set of tiles on the board.
+class MonteCarloEstimator {
+
+public:
+	MonteCarloEstimator(int threadCount = 0) : pool(threadCount) {
+		workerStates.resize(pool.size());
+	}
+
+	WinEstimate estimate(const MahjongGame& game, long long playouts, uint64_t seed, double z = 1.96) {
+		return estimate(MahjongBitboard(game), playouts, seed, z);
+	}
+
+	WinEstimate estimate(const MahjongBitboard& board, long long playouts, uint64_t seed, double z = 1.96) {
+		// playouts are handed out in chunks, small enough to balance the load and large enough to keep the counter cold
+		const long long chunkSize = 64;
+		atomic<long long> nextPlayout(0);
+		pool.run([&](int workerIdx) {
+			WorkerState& state = workerStates[workerIdx];
+			state.wins = 0;
+			state.rng.seed(seed + 0x9e3779b97f4a7c15ULL * (workerIdx + 1));
+			MahjongBitboard scratch = board;
+			while (true) {
+				long long first = nextPlayout.fetch_add(chunkSize);
+				if (first >= playouts) break;
+				long long last = min(first + chunkSize, playouts);
+				for (long long i = first; i < last; i++) {
+					scratch.present = board.present;
+					if (playout(scratch, state)) state.wins++;
+				}
+			}
+		});
+		WinEstimate result;
+		result.playouts = playouts;
+		for (WorkerState& state : workerStates) result.wins += state.wins;
+		if (playouts == 0) return result;
+		// Wilson score interval, well behaved also when the probability is close to 0 or 1
+		double n = (double)playouts;
+		double p = result.wins / n;
+		double denominator = 1.0 + z * z / n;
+		double center = (p + z * z / (2.0 * n)) / denominator;
+		double halfWidth = z * sqrt(p * (1.0 - p) / n + z * z / (4.0 * n * n)) / denominator;
+		result.probability = p;
+		result.lower = max(0.0, center - halfWidth);
+		result.upper = min(1.0, center + halfWidth);
+		return result;
+	}
+
+	int threadCount() const {
+		return pool.size();
+	}
+
+private:
+	// aligned to a cache line so that counters of different workers never share one
+	struct alignas(64) WorkerState {
+		mt19937_64 rng;
+		long long wins = 0;
+		vector<pair<int, int>> pairs;		// Legal pairs of the current step, reused between steps
+	};
+
+	ThreadPool pool;
+	vector<WorkerState> workerStates;
+
+	// plays uniformly random legal pairs, returns true if the board gets cleared
+	static bool playout(MahjongBitboard& board, WorkerState& state) {
+		while (!board.isWon()) {
+			state.pairs.clear();
+			board.forEachLegalPair([&](int idx0, int idx1) {
+				state.pairs.push_back({ idx0, idx1 });
+				return false;
+			});
+			if (state.pairs.empty()) return false;
+			uniform_int_distribution<size_t> pick(0, state.pairs.size() - 1);
+			pair<int, int> chosen = state.pairs[pick(state.rng)];
+			board.present.reset(chosen.first);
+			board.present.reset(chosen.second);
+		}
+		return true;
+	}
+};
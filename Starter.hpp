@@ -304,6 +304,8 @@ struct Pipeline {
 	void cleanup();
 };
 
+// UNIFORM blocks are sub-allocated from the uniform ring of BaseProject and bound as
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, STORAGE blocks get a buffer of their own
 enum DescriptorSetElementType {UNIFORM, TEXTURE, STORAGE};
 
 struct DescriptorSetElement {
@@ -318,7 +320,9 @@ struct DescriptorSet {
 
 	std::vector<std::vector<VkBuffer>> uniformBuffers;
 	std::vector<std::vector<VkDeviceMemory>> uniformBuffersMemory;
+	std::vector<std::vector<void *>> mappedData;	// Where every slot is written, for every image, mapped once
 	std::vector<VkDescriptorSet> descriptorSets;
+	std::vector<uint32_t> dynamicOffsets;			// Offsets of the uniform blocks in the ring, in binding order
 	
 	std::vector<bool> toFree;
 
@@ -326,7 +330,7 @@ struct DescriptorSet {
 		std::vector<DescriptorSetElement> E);
 	void cleanup();
   	void bind(VkCommandBuffer commandBuffer, Pipeline &P, int setId, int currentImage);
-  	void map(int currentImage, void *src, int size, int slot);
+  	void map(int currentImage, void *src, int size, int slot, int offset = 0);
 };
 
 
@@ -360,7 +364,7 @@ protected:
 	VkClearColorValue initialBackgroundColor;
 	int uniformBlocksInPool;
 	int texturesInPool;
-	int storageBlocksInPool;
+	int storageBlocksInPool = 0;
 	int setsInPool;
 
     GLFWwindow* window;
@@ -393,6 +397,15 @@ protected:
 	
  	VkDescriptorPool descriptorPool;
 
+	// Uniform ring: one host visible buffer for each swap chain image, mapped once, from which the
+	// uniform blocks of all the descriptor sets are sub-allocated. Rebuilt with the descriptor pool
+	VkDeviceSize uniformBytesInPool = 0;	// Size of each ring, uniformBlocksInPool * 256 if left to 0
+	VkDeviceSize uniformRingUsed = 0;
+	VkDeviceSize uniformRingAlignment = 256;
+	std::vector<VkBuffer> uniformRingBuffers;
+	std::vector<VkDeviceMemory> uniformRingMemory;
+	std::vector<uint8_t *> uniformRingData;
+
 	VkDebugUtilsMessengerEXT debugMessenger;
 	
 	VkImage depthImage;
@@ -1606,18 +1619,24 @@ protected:
 	}
     
 	void createDescriptorPool() {
-		std::array<VkDescriptorPoolSize, 2> poolSizes{};
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		createUniformRing();
+
+		std::vector<VkDescriptorPoolSize> poolSizes(2);
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		poolSizes[0].descriptorCount = static_cast<uint32_t>(uniformBlocksInPool *
 															 swapChainImages.size());
 		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		poolSizes[1].descriptorCount = static_cast<uint32_t>(texturesInPool *
 															 swapChainImages.size());
-		// Commented not to throw any validation error
-		// Uncomment if and when storage buffers are needed
-		//poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		//poolSizes[2].descriptorCount = static_cast<uint32_t>(storageBlocksInPool *
-		//		swapChainImages.size());
+		// A pool size with no descriptors is a validation error: storage buffers are only
+		// added when the application asks for some
+		if (storageBlocksInPool > 0) {
+			VkDescriptorPoolSize storageSize{};
+			storageSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			storageSize.descriptorCount = static_cast<uint32_t>(storageBlocksInPool *
+																swapChainImages.size());
+			poolSizes.push_back(storageSize);
+		}
 															 
 		VkDescriptorPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1634,6 +1653,55 @@ protected:
 
 	}
 	
+	// every uniform block is at most 256 bytes after alignment in the default size of the ring
+	VkDeviceSize uniformRingSize() {
+		return uniformBytesInPool > 0 ? uniformBytesInPool :
+				static_cast<VkDeviceSize>(uniformBlocksInPool) * 256;
+	}
+
+	void createUniformRing() {
+		VkPhysicalDeviceProperties physicalDeviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+		uniformRingAlignment = std::max<VkDeviceSize>(1,
+				physicalDeviceProperties.limits.minUniformBufferOffsetAlignment);
+		VkDeviceSize ringSize = uniformRingSize();
+		uniformRingUsed = 0;
+		uniformRingBuffers.resize(swapChainImages.size());
+		uniformRingMemory.resize(swapChainImages.size());
+		uniformRingData.resize(swapChainImages.size());
+		for (size_t i = 0; i < swapChainImages.size(); i++) {
+			createBuffer(ringSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+						 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+						 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+						 uniformRingBuffers[i], uniformRingMemory[i]);
+			void *data;
+			vkMapMemory(device, uniformRingMemory[i], 0, ringSize, 0, &data);
+			uniformRingData[i] = (uint8_t *)data;
+		}
+	}
+
+	// returns the offset of a new uniform block, the same in the ring of every image
+	uint32_t allocateUniform(VkDeviceSize size) {
+		VkDeviceSize offset = (uniformRingUsed + uniformRingAlignment - 1) /
+				uniformRingAlignment * uniformRingAlignment;
+		if (offset + size > uniformRingSize()) {
+			throw std::runtime_error("uniform ring full: raise uniformBlocksInPool or uniformBytesInPool!");
+		}
+		uniformRingUsed = offset + size;
+		return static_cast<uint32_t>(offset);
+	}
+
+	void cleanupUniformRing() {
+		for (size_t i = 0; i < uniformRingBuffers.size(); i++) {
+			vkUnmapMemory(device, uniformRingMemory[i]);
+			vkDestroyBuffer(device, uniformRingBuffers[i], nullptr);
+			vkFreeMemory(device, uniformRingMemory[i], nullptr);
+		}
+		uniformRingBuffers.clear();
+		uniformRingMemory.clear();
+		uniformRingData.clear();
+	}
+
 	virtual void populateCommandBuffer(VkCommandBuffer commandBuffer, int i) = 0;
 
 	// Create command buffers
@@ -1873,6 +1941,7 @@ protected:
 		vkDestroySwapchainKHR(device, swapChain, nullptr);		// Release the swap chain
 
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		cleanupUniformRing();
 	}
 		
     void cleanup() {
@@ -2979,26 +3048,42 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 	
 	uniformBuffers.resize(E.size());
 	uniformBuffersMemory.resize(E.size());
+	mappedData.resize(E.size());
 	toFree.resize(E.size());
+	dynamicOffsets.clear();
 
+	// dynamic offsets are given to vkCmdBindDescriptorSets in binding order
+	std::vector<std::pair<int, uint32_t>> offsetsByBinding;
+	std::vector<uint32_t> ringOffsets(E.size(), 0);
 	for (int j = 0; j < E.size(); j++) {
-		uniformBuffers[j].resize(BP->swapChainImages.size());
-		uniformBuffersMemory[j].resize(BP->swapChainImages.size());
-		if(E[j].type == UNIFORM || E[j].type == STORAGE) {
+		uniformBuffers[j].resize(BP->swapChainImages.size(), VK_NULL_HANDLE);
+		uniformBuffersMemory[j].resize(BP->swapChainImages.size(), VK_NULL_HANDLE);
+		mappedData[j].resize(BP->swapChainImages.size(), nullptr);
+		toFree[j] = false;
+		if(E[j].type == UNIFORM) {
+			ringOffsets[j] = BP->allocateUniform(E[j].size);
+			offsetsByBinding.push_back({E[j].binding, ringOffsets[j]});
+			for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
+				uniformBuffers[j][i] = BP->uniformRingBuffers[i];
+				mappedData[j][i] = BP->uniformRingData[i] + ringOffsets[j];
+			}
+		} else if(E[j].type == STORAGE) {
 			for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
 				VkDeviceSize bufferSize = E[j].size;
-				BP->createBuffer(bufferSize, E[j].type == UNIFORM ? 
-										 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT : 
-										 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				BP->createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 									 	 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 									 	 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 									 	 uniformBuffers[j][i], uniformBuffersMemory[j][i]);
+				vkMapMemory(BP->device, uniformBuffersMemory[j][i], 0, bufferSize, 0,
+							&mappedData[j][i]);
 			}
 			toFree[j] = true;
-		} else {
-			toFree[j] = false;
 		}
 	}
+	std::sort(offsetsByBinding.begin(), offsetsByBinding.end());
+	for (auto &bindingOffset : offsetsByBinding) {
+		dynamicOffsets.push_back(bindingOffset.second);
+	}
 	
 	std::vector<VkDescriptorSetLayout> layouts(BP->swapChainImages.size(),
 											   DSL->descriptorSetLayout);
@@ -3023,6 +3108,7 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 		std::vector<VkDescriptorImageInfo> imageInfo(E.size());
 		for (int j = 0; j < E.size(); j++) {
 			if(E[j].type == UNIFORM) {
+				// the offset of the block is added at bind time
 				bufferInfo[j].buffer = uniformBuffers[j][i];
 				bufferInfo[j].offset = 0;
 				bufferInfo[j].range = E[j].size;
@@ -3031,7 +3117,7 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 				descriptorWrites[j].dstSet = descriptorSets[i];
 				descriptorWrites[j].dstBinding = E[j].binding;
 				descriptorWrites[j].dstArrayElement = 0;
-				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 				descriptorWrites[j].descriptorCount = 1;
 				descriptorWrites[j].pBufferInfo = &bufferInfo[j];
 			} else if(E[j].type == STORAGE) {
@@ -3068,9 +3154,11 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 }
 
 void DescriptorSet::cleanup() {
+	// uniform blocks belong to the ring, only storage buffers are released here
 	for(int j = 0; j < uniformBuffers.size(); j++) {
 		if(toFree[j]) {
 			for (size_t i = 0; i < BP->swapChainImages.size(); i++) {
+				vkUnmapMemory(BP->device, uniformBuffersMemory[j][i]);
 				vkDestroyBuffer(BP->device, uniformBuffers[j][i], nullptr);
 				vkFreeMemory(BP->device, uniformBuffersMemory[j][i], nullptr);
 			}
@@ -3083,14 +3171,11 @@ void DescriptorSet::bind(VkCommandBuffer commandBuffer, Pipeline &P, int setId,
 	vkCmdBindDescriptorSets(commandBuffer,
 					VK_PIPELINE_BIND_POINT_GRAPHICS,
 					P.pipelineLayout, setId, 1, &descriptorSets[currentImage],
-					0, nullptr);
+					static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
 }
 
-void DescriptorSet::map(int currentImage, void *src, int size, int slot) {
-	void* data;
-
-	vkMapMemory(BP->device, uniformBuffersMemory[slot][currentImage], 0,
-						size, 0, &data);
-	memcpy(data, src, size);
-	vkUnmapMemory(BP->device, uniformBuffersMemory[slot][currentImage]);	
+// memory is host coherent and mapped for the whole life of the set: a copy is enough.
+// offset writes part of a block, e.g. a few records of a storage buffer
+void DescriptorSet::map(int currentImage, void *src, int size, int slot, int offset) {
+	memcpy((uint8_t *)mappedData[slot][currentImage] + offset, src, size);
 }
@@ -0,0 +1,93 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Fixed set of worker threads kept alive between jobs.
+// run() hands the same job to every worker, each call receives the index of the worker
+// so the job can split its own work and keep per-worker state (RNG, scratch boards, results).
+class ThreadPool {
+
+public:
+	ThreadPool(int threadCount = 0) {
+		if (threadCount <= 0) threadCount = max(1, (int)thread::hardware_concurrency());
+		for (int i = 0; i < threadCount; i++) {
+			workers.emplace_back([this, i] { workerLoop(i); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			lock_guard<mutex> lock(stateMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (thread& worker : workers) worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int size() const {
+		return (int)workers.size();
+	}
+
+	// runs job(workerIdx) once on every worker and waits for all of them to finish
+	// the first exception thrown by a worker is rethrown here
+	void run(const function<void(int)>& job) {
+		lock_guard<mutex> runLock(runMutex);
+		unique_lock<mutex> lock(stateMutex);
+		currentJob = &job;
+		pendingWorkers = size();
+		failure = nullptr;
+		generation++;
+		wake.notify_all();
+		done.wait(lock, [this] { return pendingWorkers == 0; });
+		currentJob = nullptr;
+		if (failure) rethrow_exception(failure);
+	}
+
+private:
+	vector<thread> workers;
+	mutex runMutex;						// Serializes calls to run
+	mutex stateMutex;					// Protects the fields below
+	condition_variable wake;
+	condition_variable done;
+	const function<void(int)>* currentJob = nullptr;
+	int pendingWorkers = 0;
+	unsigned long long generation = 0;	// Incremented for every job, lets workers tell a new job from a spurious wake up
+	bool stopping = false;
+	exception_ptr failure;
+
+	void workerLoop(int idx) {
+		unsigned long long seenGeneration = 0;
+		while (true) {
+			const function<void(int)>* job;
+			{
+				unique_lock<mutex> lock(stateMutex);
+				wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+				if (stopping) return;
+				seenGeneration = generation;
+				job = currentJob;
+			}
+			exception_ptr error = nullptr;
+			try {
+				(*job)(idx);
+			}
+			catch (...) {
+				error = current_exception();
+			}
+			{
+				lock_guard<mutex> lock(stateMutex);
+				if (error && !failure) failure = error;
+				if (--pendingWorkers == 0) done.notify_all();
+			}
+		}
+	}
+};
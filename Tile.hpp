@@ -1,39 +1,37 @@
-#include <glm/glm.hpp>
-#include <vector>
+#pragma once
 
+// Mutable state of a tile in a game. Position and neighbours belong to the layout, a tile only
+// keeps how many of its neighbours are still on the board
 class Tile {
 
 	public: 
 		int tileIdx;
 		int suitIdx;
-		std::vector<int> over;
-		std::vector<int> under;
-		std::vector<int> left;
-		std::vector<int> right;
-		glm::vec3 position;
+		int groupIdx = 0;	// Suit vector of the tile, tiles of the same group can be removed together
+		int overCount;		// Tiles still lying on top of this one
+		int leftCount;		// Tiles still touching this one on the left
+		int rightCount;		// Tiles still touching this one on the right
 		bool isRemoved = false;
 
-		Tile(int tileIdx, int suitIdx,
-			std::vector<int> over,
-			std::vector<int> under,
-			std::vector<int> left,
-			std::vector<int> right,
-			glm::vec3 position
-			) {
+		Tile(int tileIdx, int suitIdx, int overCount, int leftCount, int rightCount) {
 			this->tileIdx = tileIdx;
 			this->suitIdx = suitIdx;
-			this->over = over;
-			this->under = under;
-			this->left = left;
-			this->right = right;
-			this->position = position;
+			this->overCount = overCount;
+			this->leftCount = leftCount;
+			this->rightCount = rightCount;
 		};
 
-		bool isOpen() {
-			return (over.size() == 0 && (left.size() == 0 ||right.size() == 0));
+		bool isOpen() const {
+			return (overCount == 0 && (leftCount == 0 || rightCount == 0));
 		}
 
-		int getSuitVectorIndex() {
+		int getSuitVectorIndex() const {
+			return groupIdx;
+		}
+
+		// index of the group of tiles removable together with a tile of the given suit, in the standard
+		// set of 144 tiles. Used to group the suits of structures that do not list their own groups
+		static int suitVectorIndexOf(int suitIdx) {
 			if (suitIdx < 37) return suitIdx - suitIdx / 10;
 			if (suitIdx >= 40 && suitIdx < 44) return 34;
 			//if (tileIdx >= 44) 
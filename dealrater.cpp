@@ -0,0 +1,105 @@
+// DEAL DIFFICULTY RATER
+
+// Rates a range of deals and writes one CSV row per seed, to pick deals by difficulty. Usage:
+//   dealrater firstSeed count [solvable|shuffle] [threads] [node limit] [output.csv]
+// Seeds are rated in parallel on all the cores, rows are written in seed order as soon as they are
+// ready, so a run stopped halfway leaves a valid file with the seeds rated so far.
+
+#include "DealRater.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+const char* resultName(SolverResult result) {
+	switch (result) {
+		case SOLVER_SOLVABLE: return "solvable";
+		case SOLVER_UNSOLVABLE: return "unsolvable";
+		default: return "unknown";
+	}
+}
+
+void writeRow(ostream& out, const DealRating& rating) {
+	out << rating.seed << ',' << resultName(rating.result) << ',' << rating.solverNodes << ','
+		<< rating.firstMoves << ',' << rating.winningMoves << ',' << rating.unknownMoves << ','
+		<< rating.branchingFactor << ',' << rating.deadEndRate << '\n';
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		cerr << "Usage: dealrater firstSeed count [solvable|shuffle] [threads] [node limit] [output.csv]" << endl;
+		return EXIT_FAILURE;
+	}
+	string structurePath = "./structure.json";
+	uint64_t firstSeed = stoull(argv[1]);
+	long long count = stoll(argv[2]);
+	DealMode dealMode = (argc > 3 && string(argv[3]) == "shuffle") ? DEAL_RANDOM : DEAL_SOLVABLE;
+	int threads = argc > 4 ? stoi(argv[4]) : 0;
+	long long nodeLimit = argc > 5 ? stoll(argv[5]) : 100000;
+	string outputPath = argc > 6 ? argv[6] : "./ratings.csv";
+
+	try {
+		shared_ptr<const MahjongLayout> layout = MahjongLayout::open(structurePath);
+		ofstream out(outputPath, ios::trunc);
+		if (!out) throw runtime_error("Unable to write " + outputPath);
+		out << "seed,result,solver_nodes,first_moves,winning_moves,unknown_moves,branching_factor,dead_end_rate\n";
+
+		// seeds are handed out in chunks, finished chunks wait in pending until all the previous ones are written
+		const long long chunkSize = 64;
+		atomic<long long> nextChunk(0);
+		mutex outputMutex;
+		map<long long, string> pending;
+		long long nextToWrite = 0;
+		long long written = 0;
+		auto startTime = chrono::steady_clock::now();
+		auto lastReport = startTime;
+		ThreadPool pool(threads);
+		pool.run([&](int) {
+			MahjongGame game = MahjongGame(layout, dealMode, firstSeed);
+			DealRater rater(nodeLimit);
+			long long chunk;
+			while ((chunk = nextChunk.fetch_add(1)) * chunkSize < count) {
+				ostringstream rows;
+				rows << fixed << setprecision(4);
+				long long last = min((chunk + 1) * chunkSize, count);
+				for (long long i = chunk * chunkSize; i < last; i++) {
+					game.newGame(dealMode, firstSeed + i);
+					writeRow(rows, rater.rate(game));
+				}
+				lock_guard<mutex> lock(outputMutex);
+				pending[chunk] = rows.str();
+				for (auto it = pending.begin(); it != pending.end() && it->first == nextToWrite; it = pending.erase(it)) {
+					out << it->second;
+					written = min((++nextToWrite) * chunkSize, count);
+				}
+				auto now = chrono::steady_clock::now();
+				if (now - lastReport > chrono::seconds(10)) {
+					lastReport = now;
+					out.flush();
+					cerr << written << " / " << count << " seeds\n";
+				}
+			}
+		});
+		out.flush();
+		if (!out) throw runtime_error("Unable to write " + outputPath);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+		cout << fixed << setprecision(2);
+		cout << "Seeds:      " << count << " (" << firstSeed << " to " << firstSeed + count - 1 << ", "
+			<< (dealMode == DEAL_SOLVABLE ? "solvable" : "shuffled") << " deals, " << pool.size() << " threads)\n";
+		cout << "Throughput: " << count / seconds << " seeds/s\n";
+		cout << "Ratings:    " << outputPath << "\n";
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+// LAYOUT COMPILER
+
+// Turns json structures into compiled layouts (.mjl), which the game maps in memory without any
+// parsing. Usage:
+//   layoutcompiler structure.json [more.json ...]
+// Each structure is compiled next to itself, with the .mjl extension.
+
+#include "MahjongLayout.hpp"
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		cerr << "Usage: layoutcompiler structure.json [more.json ...]" << endl;
+		return EXIT_FAILURE;
+	}
+	int failures = 0;
+	for (int i = 1; i < argc; i++) {
+		string jsonPath = argv[i];
+		string binaryPath = filesystem::path(jsonPath).replace_extension(".mjl").string();
+		try {
+			MahjongLayout::compile(jsonPath, binaryPath);
+			// map the result back, so that a broken file is reported here and not by the game
+			shared_ptr<const MahjongLayout> layout = MahjongLayout::open(binaryPath);
+			cout << jsonPath << " -> " << binaryPath << " (" << layout->tileCount() << " tiles, "
+				<< layout->groupCount() << " suit groups)" << endl;
+		}
+		catch (const std::exception& e) {
+			cerr << jsonPath << ": " << e.what() << endl;
+			failures++;
+		}
+	}
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -4,6 +4,11 @@
 
 #include "Starter.hpp"
 #include "MahjongGame.hpp"
+#include "HintEngine.hpp"
+#include "MahjongReplay.hpp"
+#include "MahjongSnapshot.hpp"
+#include "DeadlockAnalyzer.hpp"
+#include "DealPool.hpp"
 
 #include <glm/ext/vector_common.hpp>
 #include <glm/ext/scalar_common.hpp>
@@ -31,20 +36,35 @@ struct CommonUniformBlock {
 	alignas(4) int objectIdx;				// Id used to identify object for selection
 };
 
-struct TileUniformBlock {
-	alignas(4) float amb;					// Coefficient to regulate the effect of ambient light on the tile
+// Values shared by all the tiles, written once per frame
+struct TileSharedBlock {
+	alignas(16) glm::mat4 prjView;			// Projection * View
+	alignas(16) glm::mat4 boardWorld;		// Base of the board, tiles are translated from here
+	alignas(16) glm::mat4 menuWorld;		// World matrix of the rotating tile of the home screen
+	alignas(16) glm::vec3 sColor;			// Specular color of the board tiles
+	alignas(4) float amb;					// Coefficient to regulate the effect of ambient light on the board tiles
+	alignas(16) glm::vec3 menuSColor;		// Specular color of the home screen tile
+	alignas(4) float menuAmb;				// Ambient coefficient of the home screen tile
 	alignas(4) float gamma;					// Gamma coefficient for Blinn shader
-	alignas(16) glm::vec3 sColor;			// Specular color
-	alignas(16) glm::mat4 mvpMat;
-	alignas(16) glm::mat4 mMat;
-	alignas(16) glm::mat4 nMat;
-	alignas(4) int tileIdx;					// Index of the tile on the board
-	alignas(4) int suitIdx;					// Index of the tile w.r.t. the drawing on it
-	alignas(4) float transparency;			// Transparency of the tile, used in disappearing animation
+	alignas(4) float fadingTransparency;	// Transparency of the tiles flagged TILE_FADING, used in disappearing animation
 	alignas(4) int hoverIdx;				// Index of the tile on which the mouse cursor is hovering
-	alignas(4) int selectedIdx;				// Index of the tile that is already selected in game
-	alignas(4) int textureIdx;			
-	alignas(4) int isInMenu;				// Either 0 or 1, used to define if the tile is in the menu or in game and change lightr accordingly
+	alignas(4) int textureIdx;
+};
+
+// Flags of a tile record, stored above the 16 bits of the suit
+enum TileFlags : uint32_t {
+	TILE_REMOVED = 1u << 16,				// Not drawn
+	TILE_SELECTED = 1u << 17,				// Selected by the player
+	TILE_HINT = 1u << 18,					// Part of the suggested pair
+	TILE_FADING = 1u << 19,					// Disappearing
+	TILE_MENU = 1u << 20					// Rotating tile of the home screen, placed by menuWorld and lit as in the menu
+};
+static_assert(LAYOUT_MAX_SUIT < TILE_REMOVED, "suits of a layout must fit below the tile flags");
+
+// Data of one tile, all the tiles are read from the same storage buffer (std430 layout) indexed by instance
+struct TileStorageBlock {
+	alignas(16) glm::vec3 position;			// Position on the board, relative to boardWorld
+	alignas(4) uint32_t suitAndFlags;		// Index of the drawing on the tile in the low 16 bits, TileFlags above
 };
 
 struct RoughSurfaceUniformBlock {
@@ -97,6 +117,9 @@ struct VertexUI {
 //----------------------
 
 class Mahjong : public BaseProject {
+public:
+	Mahjong(DealMode dealMode) : dealMode(dealMode) {}
+
 protected:
 
 	//----------------------
@@ -108,7 +131,7 @@ protected:
 
 	// Descriptor Set Layouts
 	DescriptorSetLayout DSLGubo;		// DSL for GlobalUniformBufferObject
-	DescriptorSetLayout DSLTile;		// DSL for Tile objects
+	DescriptorSetLayout DSLTile;		// DSL for Tile objects, a storage buffer with all of them
 	DescriptorSetLayout DSLPlain;		// DSL with 1 UNIFORM and 1 TEXTURE
 	DescriptorSetLayout DSLGeneric;		// DSL with 2 UNIFORM and 1 TEXTURE
 	DescriptorSetLayout DSLTextureOnly;	// DSL with only 1 TEXTURE
@@ -158,14 +181,13 @@ protected:
 
 	DescriptorSet DSGubo;
 	DescriptorSet DSBackground;
-	DescriptorSet DSTile[144];
+	DescriptorSet DSTiles;			// Tiles of the layout followed by the tile of the home screen
 	DescriptorSet DSTileTexture;
 	DescriptorSet DSWall;
 	DescriptorSet DSFloor;
 	DescriptorSet DSCeiling;
 	DescriptorSet DSTable;
 	DescriptorSet DSWindow1, DSWindow2, DSWindow3;
-	DescriptorSet DSHTile;
 	DescriptorSet DSHome;
 	DescriptorSet DSGameTitle;
 	DescriptorSet DSLandscape;
@@ -238,8 +260,12 @@ protected:
 
 	// C++ storage for uniform variables
 	GlobalUniformBlock gubo; 
-	TileUniformBlock tileubo[144];
-	TileUniformBlock tileHomeubo; // Rotating tile in home menu screen 
+	vector<TileStorageBlock> tileubo;	// One for each tile of the layout, then the rotating tile of the home screen
+	TileSharedBlock tileSharedubo;
+	vector<uint32_t> tileDirtyImages;	// Bit i is set if the record of the tile is not yet in the buffer of swap chain image i
+	vector<int> dirtyTiles;				// Tiles with some bit set in tileDirtyImages
+	vector<int> changedTiles;			// Tiles changed by the game since the last frame
+	vector<int> highlightedTiles;		// Tiles selected, suggested or disappearing in the last frame
 	RoughSurfaceUniformBlock bgubo;
 	RoughSurfaceUniformBlock wallubo;
 	RoughSurfaceUniformBlock floorubo;
@@ -309,6 +335,24 @@ protected:
 	// [40] - Blackboard Text
 	CommonUniformBlock commonubo[41];
 
+	// Cached transform of a scene object: its world matrix is only rebuilt when the model inputs it
+	// depends on change, its mvp when the world matrix or the camera change, and its block is only
+	// copied to the buffer of a swap chain image when something in it changed since the last copy
+	struct ObjectTransform {
+		glm::mat4 world;
+		uint64_t worldKey = 0;			// Model inputs the world matrix was built from
+		bool placed = false;			// False before the first frame
+		uint64_t viewVersion = 0;		// Version of prjView the mvp was computed with
+		float transparency = 0.0f;		// Values of the block when it was last copied
+		int textureIdx = 0;
+		int objectIdx = 0;
+		uint32_t uploadedImages = 0;	// Bit i is set if the block is up to date in the buffer of swap chain image i
+	};
+	ObjectTransform commonTransforms[41];
+	ObjectTransform tileSelTextTransform, boardSelTextTransform;
+	glm::mat4 prjView;						// Projection * View of the current frame
+	uint64_t viewVersion = 0;				// Increased every time prjView changes
+
 	// Other application parameters
 	int tileTextureIdx = 0;					// Id of the current tile texture 
 	int boardTextureIdx = 0;				// Id of the current board texture
@@ -330,6 +374,16 @@ protected:
 	
 	// Other parameters
 	int gameState = -1;
+	string structurePath = "./structure.json";
+	shared_ptr<const MahjongLayout> layout;	// Loaded in setWindowParameters, shared with the game
+	DealMode dealMode;						// Either DEAL_SOLVABLE (always winnable) or DEAL_RANDOM (plain shuffle), from the command line
+	HintEngine hintEngine;					// Searches the suggested pair in background
+	unique_ptr<DealPool> dealPool;			// Deals prepared in background, one is taken at every Play
+	shared_ptr<const EndgameTable> endgames;	// Tablebase of the deal being played, if one was built
+	bool showHint = false;					// True after the hint key is pressed, until the board changes
+	const string quickSavePath = "./quicksave.mjs";
+	vector<uint8_t> quickSaveBlob;			// Last snapshot saved or loaded with F5/F9
+	string dealTitle;						// Title bar while a deal is played: the seed to replay it, then the warnings
 	int isCandleAlight = 0;
 	glm::vec3 generalSColor = glm::vec3(1.0f, 1.0f, 1.0f);
 	float DisappearingTileTransparency = 1.0f;
@@ -342,6 +396,47 @@ protected:
 	const glm::mat4 homeMenuWorld = glm::translate(glm::mat4(1.0f), homeMenuPosition);
 
 
+	// the record will be written to the buffer of every swap chain image, each one on its next frame
+	void markTileDirty(int idx) {
+		if (tileDirtyImages[idx] == 0) dirtyTiles.push_back(idx);
+		tileDirtyImages[idx] = (1u << swapChainImages.size()) - 1;
+	}
+
+	// rebuilds the world matrix of an object with makeWorld only when worldKey, the model inputs it
+	// depends on, changed, and the matrices derived from it only when the world or the camera changed
+	template <class MakeWorld>
+	void placeObject(CommonUniformBlock& block, ObjectTransform& transform, uint64_t worldKey, MakeWorld makeWorld) {
+		if (!transform.placed || worldKey != transform.worldKey) {
+			transform.world = makeWorld();
+			transform.worldKey = worldKey;
+			transform.placed = true;
+			transform.viewVersion = 0;
+			block.mMat = transform.world;
+			block.nMat = glm::inverse(glm::transpose(transform.world));
+		}
+		if (transform.viewVersion != viewVersion) {
+			block.mvpMat = prjView * transform.world;
+			transform.viewVersion = viewVersion;
+			transform.uploadedImages = 0;
+		}
+	}
+
+	// copies the block to the buffer of the current image, unless that buffer already holds it
+	void uploadObject(DescriptorSet& ds, int currentImage, CommonUniformBlock& block, ObjectTransform& transform) {
+		if (block.transparency != transform.transparency || block.textureIdx != transform.textureIdx ||
+			block.objectIdx != transform.objectIdx) {
+			transform.transparency = block.transparency;
+			transform.textureIdx = block.textureIdx;
+			transform.objectIdx = block.objectIdx;
+			transform.uploadedImages = 0;
+		}
+		uint32_t imageBit = 1u << currentImage;
+		if (!(transform.uploadedImages & imageBit)) {
+			ds.map(currentImage, &block, sizeof(block), 0);
+			transform.uploadedImages |= imageBit;
+		}
+	}
+
 	// Main application parameters
 	void setWindowParameters() {
 		// Window size, title and initial background
@@ -351,10 +446,21 @@ protected:
 		windowResizable = GLFW_TRUE;
 		initialBackgroundColor = { 0.0f, 0.005f, 0.01f, 1.0f };
 
-		// Descriptor pool sizes
-		uniformBlocksInPool = 217;
+		// Layout of the board, it decides how many tiles are drawn
+		layout = MahjongLayout::open(structurePath);
+		// each mode has its own pool, so that switching modes does not forget the deals played
+		dealPool = make_unique<DealPool>(layout, dealMode, dealMode == DEAL_SOLVABLE ? "./dealpool.mjd" : "./dealpool_shuffle.mjd");
+		int tileCount = layout->tileCount();
+		tileubo.resize(tileCount + 1);
+		tileubo.back().position = glm::vec3(0.0f);
+		tileubo.back().suitAndFlags = 10 | TILE_MENU;
+		tileDirtyImages.assign(tileCount + 1, 0);
+
+		// Descriptor pool sizes: all the tiles share one set and one storage buffer
+		uniformBlocksInPool = 73;
 		texturesInPool = 49;
-		setsInPool = 195;
+		storageBlocksInPool = 1;
+		setsInPool = 51;
 
 		// Initialize aspect ratio
 		Ar = (float)windowWidth / (float)windowHeight;
@@ -372,22 +478,23 @@ protected:
 	void localInit() {
 		// Descriptor Set Layouts
 		DSLTile.init(this, {
-					{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS}			// Tile block
+					{0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS},			// Tile blocks
+					{1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS}			// Shared tile block
 			});
 		DSLPlain.init(this, {
-					{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS},			// Common block
+					{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS},			// Common block
 					{1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT}	// Texture
 			});
 		DSLGeneric.init(this, {
-					{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS},			// Common block
-					{1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS},			// Shading block
+					{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS},			// Common block
+					{1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS},			// Shading block
 					{2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT}	// Texture
 			});
 		DSLTextureOnly.init(this, {
 					{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT},	// Texture
 			});
 		DSLGubo.init(this, {
-					{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS}			// Gubo block
+					{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS}			// Gubo block
 			});
 		// Vertex descriptors
 		VMesh.init(this, {
@@ -903,14 +1010,14 @@ protected:
 			});
 
 		// Tile
-		for (int i = 0; i < 144; i++) {
-			DSTile[i].init(this, &DSLTile, {
-						{0, UNIFORM, sizeof(TileUniformBlock), nullptr}
-				});
-		}
-		DSHTile.init(this, &DSLTile, {
-				{0, UNIFORM, sizeof(TileUniformBlock), nullptr},
+		DSTiles.init(this, &DSLTile, {
+					{0, STORAGE, (int)(sizeof(TileStorageBlock) * tileubo.size()), nullptr},
+					{1, UNIFORM, sizeof(TileSharedBlock), nullptr}
 			});
+		// the buffers are new: every record has to be written again
+		for (int i = 0; i < (int)tileubo.size(); i++) markTileDirty(i);
+		for (ObjectTransform& transform : commonTransforms) transform.uploadedImages = 0;
+		tileSelTextTransform.uploadedImages = boardSelTextTransform.uploadedImages = 0;
 
 		// Texture-only
 		DSTileTexture.init(this, &DSLTextureOnly, {
@@ -1057,9 +1164,7 @@ protected:
 		// Cleanup descriptor sets
 		DSGubo.cleanup();
 		DSBackground.cleanup();
-		for (int i = 0; i < 144; i++) {
-			DSTile[i].cleanup();
-		}
+		DSTiles.cleanup();
 		DSWall.cleanup();
 		DSFloor.cleanup();
 		DSCeiling.cleanup();
@@ -1089,7 +1194,6 @@ protected:
 		DSBackToMenu.cleanup();
 		DSYesButton.cleanup();
 		DSNoButton.cleanup();
-		DSHTile.cleanup();
 		DSHome.cleanup();
 		DSGameTitle.cleanup();
 		DSButton1.cleanup();
@@ -1289,20 +1393,14 @@ protected:
 
 		// PTile
 		
-		// Tiles in main structure
+		// Tiles in main structure and tile in home screen, one instance each
 		PTile.bind(commandBuffer);
 		MTile.bind(commandBuffer);
 		DSGubo.bind(commandBuffer, PTile, 0, currentImage);
+		DSTiles.bind(commandBuffer, PTile, 1, currentImage);
 		DSTileTexture.bind(commandBuffer, PTile, 2, currentImage);
-		for (int i = 0; i < 144; i++) {
-			DSTile[i].bind(commandBuffer, PTile, 1, currentImage);
-			vkCmdDrawIndexed(commandBuffer,
-				static_cast<uint32_t>(MTile.indices.size()), 1, 0, 0, 0);
-		}
-		// Tile in home screen
-		DSHTile.bind(commandBuffer, PTile, 1, currentImage);
 		vkCmdDrawIndexed(commandBuffer,
-			static_cast<uint32_t>(MTile.indices.size()), 1, 0, 0, 0);
+			static_cast<uint32_t>(MTile.indices.size()), static_cast<uint32_t>(tileubo.size()), 0, 0, 0);
 
 
 		// PRoughSurfaces
@@ -1469,6 +1567,47 @@ protected:
 	//---------------------
 	// MAIN UPDATE CYCLE
 	//---------------------
+	// Warns in the title bar as soon as the board can no longer be cleared, before the legal pairs run out
+	void updateDeadlockWarning(const MahjongGame& game) {
+		bool lost = false;
+		if (game.tiles.size() <= MAHJONG_MAX_TILES && !game.isWon() && !game.isGameOver()) {
+			MahjongBitboard board(game);
+			lost = DeadlockAnalyzer(board).isDeadlocked(board) ||
+				(endgames && endgames->matches(board) && endgames->probe(board.present) == SOLVER_UNSOLVABLE);
+		}
+		string title = lost ? dealTitle + " - this board can no longer be cleared" : dealTitle;
+		glfwSetWindowTitle(window, title.c_str());
+	}
+
+	// Messages for the player go to the title bar, until the board changes again
+	void showStatus(const string& message) {
+		glfwSetWindowTitle(window, (dealTitle + " - " + message).c_str());
+	}
+
+	// Sets up what depends on the deal being played, difficulty is negative when it is not known
+	void startDeal(const MahjongGame& game, double difficulty) {
+		// Pictures for the picture frames depend on the seed of the deal, so a replayed game looks the same
+		std::mt19937_64 rng(game.seed);
+		pictureFrameImageIdx1 = rng() % 4;
+		pictureFrameImageIdx2 = rng() % 5;
+		dealTitle = windowTitle + " - deal " + to_string(game.seed);
+		if (difficulty >= 0.0) dealTitle += ", difficulty " + to_string((int)round(difficulty * 100.0)) + "%";
+
+		// Endgame tablebase of the deal, when one was built with tablebase.cpp
+		endgames = nullptr;
+		string endgamePath = "./endgame_" + to_string(game.seed) + ".mjt";
+		if (filesystem::exists(endgamePath)) {
+			try {
+				endgames = EndgameTable::open(endgamePath);
+			}
+			catch (const std::exception& e) {
+				// the deal is played without the table, the reason stays in the title bar
+				dealTitle += " - endgame table ignored: " + string(e.what());
+			}
+		}
+		hintEngine.setEndgames(endgames);
+	}
+
 	void updateUniformBuffer(uint32_t currentImage) {
 
 		//---------------------
@@ -1499,6 +1638,42 @@ protected:
 		bool handleClick = (wasClick && (!click)); 
 		wasClick = click; 
 
+		// To debounce the pressing of the hint key
+		static bool wasHint = false;
+		bool hint = glfwGetKey(window, GLFW_KEY_H);
+		bool handleHint = (wasHint && (!hint));
+		wasHint = hint;
+
+		// To debounce the pressing of the undo and redo keys
+		static bool wasUndo = false, wasRedo = false;
+		bool undo = glfwGetKey(window, GLFW_KEY_Z);
+		bool redo = glfwGetKey(window, GLFW_KEY_Y);
+		bool handleUndo = (wasUndo && (!undo));
+		bool handleRedo = (wasRedo && (!redo));
+		wasUndo = undo;
+		wasRedo = redo;
+
+		// To debounce the pressing of the key saving the replay of the game
+		static bool wasRecord = false;
+		bool record = glfwGetKey(window, GLFW_KEY_P);
+		bool handleRecord = (wasRecord && (!record));
+		wasRecord = record;
+
+		// To debounce the pressing of the quick save and quick load keys
+		static bool wasQuickSave = false, wasQuickLoad = false;
+		bool quickSave = glfwGetKey(window, GLFW_KEY_F5);
+		bool quickLoad = glfwGetKey(window, GLFW_KEY_F9);
+		bool handleQuickSave = (wasQuickSave && (!quickSave));
+		bool handleQuickLoad = (wasQuickLoad && (!quickLoad));
+		wasQuickSave = quickSave;
+		wasQuickLoad = quickLoad;
+
+		// To debounce the pressing of the reshuffle key
+		static bool wasReshuffle = false;
+		bool reshuffle = glfwGetKey(window, GLFW_KEY_X);
+		bool handleReshuffle = (wasReshuffle && (!reshuffle));
+		wasReshuffle = reshuffle;
+
 		// To get the position of the cursor on screen
 		double mousex, mousey;
 		glfwGetCursorPos(window, &mousex, &mousey);
@@ -1522,8 +1697,7 @@ protected:
 
 
 		// Initialization of the game
-		string structurePath = "./structure.json";
-		static MahjongGame game = MahjongGame(structurePath);
+		static MahjongGame game = MahjongGame(layout, dealMode);
 		static bool reset = false;
 
 
@@ -1536,7 +1710,8 @@ protected:
 			case -1: // Menu	
 
 				if (reset) {
-					game = MahjongGame(structurePath);
+					// the next deal is taken from the pool at Play
+					glfwSetWindowTitle(window, windowTitle.c_str());
 					boardTextureIdx = 0;
 					tileTextureIdx = 0;
 					circleTextureIdx = 0;
@@ -1579,21 +1754,22 @@ protected:
 				if (handleClick && hoverIndex == -30) {
 					gameState = 0;
 
-					// Random gen of the index to use to chose the picture for the picture frame
-					int max = 3;
-					int min = 0;
-					std::mt19937 rng(time(NULL));
-					std::uniform_int_distribution<int> gen(min, max);
-					pictureFrameImageIdx1 = gen(rng);
+					// Deal prepared in background, dealt here only if the pool has run dry
+					double difficulty = -1.0;
+					if (!dealPool->pop(game, difficulty)) {
+						game.newGame(dealMode);
+						dealPool->markPlayed(game);
+					}
 
-					max = 4;
-					std::mt19937 rng2(time(NULL));
-					std::uniform_int_distribution<int> gen2(min, max);
-					pictureFrameImageIdx2 = gen2(rng);
+					startDeal(game, difficulty);
 
 					PlaySound(TEXT("sounds/button_click.wav"), NULL, SND_FILENAME | SND_ASYNC);
 
 					enterPressedFirstTime = true;
+					// Start looking for a hint on the new board
+					hintEngine.boardChanged(game);
+					showHint = false;
+					updateDeadlockWarning(game);
 				}
 				break;
 			case 0:
@@ -1651,6 +1827,9 @@ protected:
 			case 5:
 				// Remove the tile
 				game.removeTiles(firstTileIndex, secondTileIndex);
+				hintEngine.boardChanged(game);
+				showHint = false;
+				updateDeadlockWarning(game);
 				if (game.isWon() || game.isGameOver()) {
 					gameState = 6;
 				}
@@ -1669,6 +1848,7 @@ protected:
 					gameoverubo.visible = 1.0f;
 					youwinubo.visible = 0.0f;
 					PlaySound(TEXT("sounds/retro_error_long_tone.wav"), NULL, SND_FILENAME | SND_ASYNC);
+					showStatus("no pair left, press X to reshuffle the remaining tiles");
 				}
 				gameState = 7;
 				break;
@@ -1708,6 +1888,81 @@ protected:
 		if ((gameState==1 || gameState== 0) && mButton) {
 			gameState = 8;
 		}
+		// Undo or redo the last pair, also allowed after the game has ended
+		if ((gameState == 1 || gameState == 0 || gameState == 7) && (handleUndo || handleRedo)) {
+			if ((handleUndo && game.undo()) || (handleRedo && game.redo())) {
+				gameoverubo.visible = 0.0f;
+				youwinubo.visible = 0.0f;
+				firstTileIndex = -1;
+				secondTileIndex = -1;
+				gameState = (game.isWon() || game.isGameOver()) ? 6 : 0;
+				hintEngine.boardChanged(game);
+				showHint = false;
+				updateDeadlockWarning(game);
+			}
+		}
+		// Deal again the suits of the tiles left when the player is stuck, into a position that can be won
+		if (gameState == 7 && game.isGameOver() && handleReshuffle) {
+			if (game.reshuffle()) {
+				gameoverubo.visible = 0.0f;
+				firstTileIndex = -1;
+				secondTileIndex = -1;
+				gameState = 0;
+				hintEngine.boardChanged(game);
+				showHint = false;
+				updateDeadlockWarning(game);
+			}
+			else {
+				showStatus("the remaining tiles cannot be cleared whatever their suits");
+			}
+		}
+		// Save the replay of the game being played, named after its seed
+		if (gameState >= 0 && handleRecord) {
+			string replayPath = "./replay_" + to_string(game.seed) + ".mjr";
+			MahjongReplay::record(game).save(replayPath);
+			showStatus("replay saved to " + replayPath);
+		}
+		// Quick save and load of the game in progress, only while waiting for the player
+		if ((gameState == 1 || gameState == 0) && handleQuickSave) {
+			MahjongSnapshot::save(game, { gameState, firstTileIndex, secondTileIndex }, quickSaveBlob);
+			ofstream out(quickSavePath, ios::binary | ios::trunc);
+			out.write((const char*)quickSaveBlob.data(), quickSaveBlob.size());
+		}
+		if ((gameState == 1 || gameState == 0 || gameState == 7) && handleQuickLoad) {
+			ifstream in(quickSavePath, ios::binary);
+			quickSaveBlob.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+			try {
+				SessionState session = MahjongSnapshot::restore(game, quickSaveBlob);
+				gameoverubo.visible = 0.0f;
+				youwinubo.visible = 0.0f;
+				firstTileIndex = session.firstTileIndex;
+				secondTileIndex = session.secondTileIndex;
+				// snapshots are only taken with no tile or one tile selected
+				bool validSelection = firstTileIndex >= 0 && firstTileIndex < (int)game.tiles.size() && !game.tiles[firstTileIndex].isRemoved;
+				gameState = (session.gameState == 1 && validSelection) ? 1 : 0;
+				if (game.isWon() || game.isGameOver()) gameState = 6;
+				// the save may hold another deal than the one being played
+				startDeal(game, -1.0);
+				dealPool->markPlayed(game);
+				hintEngine.boardChanged(game);
+				showHint = false;
+				updateDeadlockWarning(game);
+			}
+			catch (const std::exception& e) {
+				// missing or stale save, the game goes on untouched
+				showStatus("quick load failed: " + string(e.what()));
+			}
+		}
+		// Highlight the suggested pair once the hint key is released
+		if ((gameState == 1 || gameState == 0) && handleHint) {
+			showHint = true;
+		}
+		int hintTileIndex0 = -1;
+		int hintTileIndex1 = -1;
+		if (!showHint || !hintEngine.getHint(hintTileIndex0, hintTileIndex1)) {
+			hintTileIndex0 = -1;
+			hintTileIndex1 = -1;
+		}
 
 		//---------------------------
 		// CAMERA SETTINGS
@@ -1752,6 +2007,11 @@ protected:
 
 
 		glm::mat4 View = glm::lookAt(camPos, camTarget, glm::vec3(0, 1, 0));
+		// objects only refresh their mvp when the camera has moved
+		if (viewVersion == 0 || Prj * View != prjView) {
+			prjView = Prj * View;
+			viewVersion++;
+		}
 
 
 		//--------------------------
@@ -1861,168 +2121,116 @@ protected:
 		glm::mat4 translateUp = glm::translate(glm::mat4(2.0f), glm::vec3(0.0f, 1.5f, 0.0f));
 
 		// Home screen background
-		glm::mat4 WorldH = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.5f, 0.0f)) * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 4.0f);
-		commonubo[9].mvpMat = Prj * View * WorldH;
-		commonubo[9].mMat = WorldH;
-		commonubo[9].nMat = glm::inverse(glm::transpose(WorldH));
+		placeObject(commonubo[9], commonTransforms[9], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -4.5f, 0.0f)) * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 4.0f); });
 		commonubo[9].transparency = 0.0f;
 		commonubo[9].textureIdx = boardTextureIdx;
-		DSHome.map(currentImage, &commonubo[9], sizeof(commonubo[9]), 0);
+		uploadObject(DSHome, currentImage, commonubo[9], commonTransforms[9]);
 
 		// Button1
-		glm::mat4 WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -0.15f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.3f);
-		commonubo[11].mvpMat = Prj * View * WorldB;
-		commonubo[11].mMat = WorldB;
-		commonubo[11].nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(commonubo[11], commonTransforms[11], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -0.15f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.3f); });
 		commonubo[11].transparency = 1.0f;
 		commonubo[11].textureIdx = 0;
-		DSButton1.map(currentImage, &commonubo[11], sizeof(commonubo[11]), 0);
+		uploadObject(DSButton1, currentImage, commonubo[11], commonTransforms[11]);
 
 		// Tile Selection Text
-		WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -0.15f, 0.13f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.3f);
-		tileSelTextubo.mvpMat = Prj * View * WorldB;
-		tileSelTextubo.mMat = WorldB;
-		tileSelTextubo.nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(tileSelTextubo, tileSelTextTransform, 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -0.15f, 0.13f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.3f); });
 		tileSelTextubo.transparency = 1.0f;
 		tileSelTextubo.textureIdx = tileTextureIdx;
-		DSTileSelText.map(currentImage, &tileSelTextubo, sizeof(tileSelTextubo), 0);
+		uploadObject(DSTileSelText, currentImage, tileSelTextubo, tileSelTextTransform);
 
 		// Button2
-		WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -1.8f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.3f);
-		commonubo[12].mvpMat = Prj * View * WorldB;
-		commonubo[12].mMat = WorldB;
-		commonubo[12].nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(commonubo[12], commonTransforms[12], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -1.8f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.3f); });
 		commonubo[12].transparency = 1.0f;
 		commonubo[12].textureIdx = 0;
-		DSButton2.map(currentImage, &commonubo[12], sizeof(commonubo[12]), 0);
+		uploadObject(DSButton2, currentImage, commonubo[12], commonTransforms[12]);
 
 		// Board Selection Text
-		WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -1.8f, 0.13f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.3f);
-		boardSelTextubo.mvpMat = Prj * View * WorldB;
-		boardSelTextubo.mMat = WorldB;
-		boardSelTextubo.nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(boardSelTextubo, boardSelTextTransform, 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -1.8f, 0.13f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.3f); });
 		boardSelTextubo.transparency = 1.0f;
 		boardSelTextubo.textureIdx = boardTextureIdx;
-		DSBoardSelText.map(currentImage, &boardSelTextubo, sizeof(boardSelTextubo), 0);
+		uploadObject(DSBoardSelText, currentImage, boardSelTextubo, boardSelTextTransform);
 
 		/*//Button3
-		WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -1.0f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f);
-		commonubo[13].mvpMat = Prj * View * WorldB;
-		commonubo[13].mMat = WorldB;
-		commonubo[13].nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(commonubo[13], commonTransforms[13], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -1.0f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f); });
 		commonubo[13].transparency = 1.0f;
 		commonubo[13].textureIdx = 0;
-		DSButton3.map(currentImage, &commonubo[13], sizeof(commonubo[13]), 0);*/
+		uploadObject(DSButton3, currentImage, commonubo[13], commonTransforms[13]);*/
 
 		// Arrow button 1 Left
-		glm::mat4 WorldA_B = glm::translate(glm::mat4(1.0f), glm::vec3(0.35f, 0.0f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f);
-		commonubo[14].mvpMat = Prj * View * WorldA_B;
-		commonubo[14].mMat = WorldA_B;
-		commonubo[14].nMat = glm::inverse(glm::transpose(WorldA_B));
+		placeObject(commonubo[14], commonTransforms[14], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(0.35f, 0.0f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f); });
 		commonubo[14].transparency = 1.0f;
 		commonubo[14].textureIdx = 0;
 		commonubo[14].objectIdx = -41;
-		DSArrowButton1_left.map(currentImage, &commonubo[14], sizeof(commonubo[14]), 0);
+		uploadObject(DSArrowButton1_left, currentImage, commonubo[14], commonTransforms[14]);
 
 		// Arrow button 2 Left
-		WorldA_B = glm::translate(glm::mat4(1.0f), glm::vec3(0.35f, -1.65f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f);
-		commonubo[15].mvpMat = Prj * View * WorldA_B;
-		commonubo[15].mMat = WorldA_B;
-		commonubo[15].nMat = glm::inverse(glm::transpose(WorldA_B));
+		placeObject(commonubo[15], commonTransforms[15], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(0.35f, -1.65f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f); });
 		commonubo[15].transparency = 1.0f;
 		commonubo[15].textureIdx = 0;
 		commonubo[15].objectIdx = -43;
-		DSArrowButton2_left.map(currentImage, &commonubo[15], sizeof(commonubo[15]), 0);
+		uploadObject(DSArrowButton2_left, currentImage, commonubo[15], commonTransforms[15]);
 
 		// Day/night button
-		WorldA_B = glm::translate(glm::mat4(1.0f), glm::vec3(1.05f, -3.2f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f);
-		commonubo[34].mvpMat = Prj * View * WorldA_B;
-		commonubo[34].mMat = WorldA_B;
-		commonubo[34].nMat = glm::inverse(glm::transpose(WorldA_B));
+		placeObject(commonubo[34], commonTransforms[34], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(1.05f, -3.2f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f); });
 		commonubo[34].transparency = 1.0f;
 		commonubo[34].textureIdx = circleTextureIdx;
 		commonubo[34].objectIdx = -45;
-		DSCircleButton.map(currentImage, &commonubo[34], sizeof(commonubo[34]), 0);
+		uploadObject(DSCircleButton, currentImage, commonubo[34], commonTransforms[34]);
 
 		// Arrow button 1 Right
-		WorldA_B = glm::translate(glm::mat4(1.0f), glm::vec3(3.7f, 0.0f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f);
-		commonubo[17].mvpMat = Prj * View * WorldA_B;
-		commonubo[17].mMat = WorldA_B;
-		commonubo[17].nMat = glm::inverse(glm::transpose(WorldA_B));
+		placeObject(commonubo[17], commonTransforms[17], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(3.7f, 0.0f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f); });
 		commonubo[17].transparency = 1.0f;
 		commonubo[17].textureIdx = 0;
 		commonubo[17].objectIdx = -42;
-		DSArrowButton1_right.map(currentImage, &commonubo[17], sizeof(commonubo[17]), 0);
+		uploadObject(DSArrowButton1_right, currentImage, commonubo[17], commonTransforms[17]);
 
 		// Arrow button 2 Right
-		WorldA_B = glm::translate(glm::mat4(1.0f), glm::vec3(3.7f, -1.65f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f);
-		commonubo[18].mvpMat = Prj * View * WorldA_B;
-		commonubo[18].mMat = WorldA_B;
-		commonubo[18].nMat = glm::inverse(glm::transpose(WorldA_B));
+		placeObject(commonubo[18], commonTransforms[18], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(3.7f, -1.65f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f); });
 		commonubo[18].transparency = 1.0f;
 		commonubo[18].textureIdx = 0;
 		commonubo[18].objectIdx = -44;
-		DSArrowButton2_right.map(currentImage, &commonubo[18], sizeof(commonubo[18]), 0);
+		uploadObject(DSArrowButton2_right, currentImage, commonubo[18], commonTransforms[18]);
 
 		/*//Arrow button 3 Right
-		WorldA_B = glm::translate(glm::mat4(1.0f), glm::vec3(3.5f, -1.0f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f);
-		commonubo[19].mvpMat = Prj * View * WorldA_B;
-		commonubo[19].mMat = WorldA_B;
-		commonubo[19].nMat = glm::inverse(glm::transpose(WorldA_B));
+		placeObject(commonubo[19], commonTransforms[19], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(3.5f, -1.0f, 0.11f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.0f); });
 		commonubo[19].transparency = 1.0f;
 		commonubo[19].textureIdx = 0;
-		DSArrowButton3_right.map(currentImage, &commonubo[19], sizeof(commonubo[19]), 0);*/
+		uploadObject(DSArrowButton3_right, currentImage, commonubo[19], commonTransforms[19]);*/
 
 		// Play button
-		WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(-2.7f, -3.6f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.6f);
-		commonubo[20].mvpMat = Prj * View * WorldB;
-		commonubo[20].mMat = WorldB;
-		commonubo[20].nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(commonubo[20], commonTransforms[20], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(-2.7f, -3.6f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.6f); });
 		commonubo[20].transparency = 1.0f;
 		commonubo[20].textureIdx = 0;
 		commonubo[20].objectIdx = -30;
-		DSPlayButton.map(currentImage, &commonubo[20], sizeof(commonubo[20]), 0); 
+		uploadObject(DSPlayButton, currentImage, commonubo[20], commonTransforms[20]);
 		
 		// Game settings title
-		WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 1.7f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1.2f, 0.5f, 1.0f) * 1.4f);
-		commonubo[21].mvpMat = Prj * View * WorldB;
-		commonubo[21].mMat = WorldB;
-		commonubo[21].nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(commonubo[21], commonTransforms[21], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 1.7f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1.2f, 0.5f, 1.0f) * 1.4f); });
 		commonubo[21].transparency = 1.0f;
 		commonubo[21].textureIdx = 0;
-		DSSelection1.map(currentImage, &commonubo[21], sizeof(commonubo[21]), 0);
+		uploadObject(DSSelection1, currentImage, commonubo[21], commonTransforms[21]);
 
 		// Tile selection title 
-		WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 1.01f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1.2f, 0.5f, 1.0f) * 0.8f);
-		commonubo[22].mvpMat = Prj * View * WorldB;
-		commonubo[22].mMat = WorldB;
-		commonubo[22].nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(commonubo[22], commonTransforms[22], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 1.01f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1.2f, 0.5f, 1.0f) * 0.8f); });
 		commonubo[22].transparency = 1.0f;
 		commonubo[22].textureIdx = 0;
-		DSSelection2.map(currentImage, &commonubo[22], sizeof(commonubo[22]), 0);
+		uploadObject(DSSelection2, currentImage, commonubo[22], commonTransforms[22]);
 
 		// Board selection title
-		WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -0.6f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1.3f, 0.5f, 1.0f) * 0.8f);
-		commonubo[23].mvpMat = Prj * View * WorldB;
-		commonubo[23].mMat = WorldB;
-		commonubo[23].nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(commonubo[23], commonTransforms[23], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, -0.6f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1.3f, 0.5f, 1.0f) * 0.8f); });
 		commonubo[23].transparency = 1.0f;
 		commonubo[23].textureIdx = 0;
-		DSSelection3.map(currentImage, &commonubo[23], sizeof(commonubo[23]), 0);
+		uploadObject(DSSelection3, currentImage, commonubo[23], commonTransforms[23]);
 
 		// Day/night time selection title
-		WorldB = glm::translate(glm::mat4(1.0f), glm::vec3(2.65f, -3.1f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1.0f) * 0.9f);
-		commonubo[33].mvpMat = Prj * View * WorldB;
-		commonubo[33].mMat = WorldB;
-		commonubo[33].nMat = glm::inverse(glm::transpose(WorldB));
+		placeObject(commonubo[33], commonTransforms[33], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(2.65f, -3.1f, 0.12f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1.0f) * 0.9f); });
 		commonubo[33].transparency = 1.0f;
 		commonubo[33].textureIdx = 0;
-		DSSelection4.map(currentImage, &commonubo[33], sizeof(commonubo[33]), 0);
+		uploadObject(DSSelection4, currentImage, commonubo[33], commonTransforms[33]);
 		 
 		// Matrix setup for rotating tile
 		static float ang = 0.0f;
 		ang += homeTileRotSpeed * deltaT;
-		tileHomeubo.transparency = 1.0f;
 		glm::mat4 rotTileW = translateUp * homeMenuWorld *
 			glm::translate(glm::mat4(1), glm::vec3(-2.4f, -0.3f, 0.5f)) *
 			glm::rotate(glm::mat4(1), glm::radians(-80.0f), glm::vec3(1.0f, 0.0f, 0.0f)) *
@@ -2031,139 +2239,100 @@ protected:
 			glm::rotate(glm::mat4(1), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
 			glm::rotate(glm::mat4(1), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f)) *
 			glm::translate(glm::mat4(1), glm::vec3(0.0f, -0.00675f, 0.0f));
-		tileHomeubo.amb = 10.0f;
-		tileHomeubo.gamma = 300.0f;
-		tileHomeubo.sColor = glm::vec3(0.1f);
-		tileHomeubo.mvpMat = Prj * View * rotTileW;
-		tileHomeubo.mMat = rotTileW;
-		tileHomeubo.nMat = glm::inverse(glm::transpose(rotTileW));
-		tileHomeubo.tileIdx = -2;
-		tileHomeubo.suitIdx = 10;
-		tileHomeubo.selectedIdx = -10;
-		tileHomeubo.hoverIdx = -10;
-		tileHomeubo.textureIdx = tileTextureIdx;
-		tileHomeubo.isInMenu = 1;
-		DSHTile.map(currentImage, &tileHomeubo, sizeof(tileHomeubo), 0);
+		tileSharedubo.menuWorld = rotTileW;
+		tileSharedubo.menuAmb = 10.0f;
+		tileSharedubo.menuSColor = glm::vec3(0.1f);
 
 		// Matrix setup for Game Title
-		glm::mat4 WorldTitle = glm::translate(glm::mat4(1.0f), glm::vec3(-2.5f, -1.0f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.6f);
-		commonubo[10].mvpMat = Prj * View * WorldTitle;
-		commonubo[10].mMat = WorldTitle;
-		commonubo[10].nMat = glm::inverse(glm::transpose(WorldTitle));
+		placeObject(commonubo[10], commonTransforms[10], 0, [&] { return glm::translate(glm::mat4(1.0f), glm::vec3(-2.5f, -1.0f, 0.1f)) * translateUp * homeMenuWorld * glm::scale(glm::mat4(1), glm::vec3(1) * 1.6f); });
 		commonubo[10].transparency = 1.0f;
 		commonubo[10].textureIdx = 0;
-		DSGameTitle.map(currentImage, &commonubo[10], sizeof(commonubo[10]), 0);
+		uploadObject(DSGameTitle, currentImage, commonubo[10], commonTransforms[10]);
 		
 		// Matrix setup for background
-		glm::mat4 World = glm::mat4(1);
 		glm::mat4 baseTranslation = glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.0f, -0.5f));
-		World = baseTranslation * 
-				glm::translate(glm::mat4(1), glm::vec3(0.04f, 0.0f, 0.0f)) * 
-				glm::scale(glm::mat4(1), glm::vec3(3.55f, 1.0f, 1.4f));
 		bgubo.amb = 1.2f; bgubo.sigma = 0.7f;
-		commonubo[0].mvpMat = Prj * View * World;
-		commonubo[0].mMat = World;
-		commonubo[0].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[0], commonTransforms[0], 0, [&] {
+			return baseTranslation *
+				glm::translate(glm::mat4(1), glm::vec3(0.04f, 0.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(3.55f, 1.0f, 1.4f));
+		});
 		commonubo[0].transparency = 0.0f;
 		commonubo[0].textureIdx = boardTextureIdx;
-		DSBackground.map(currentImage, &commonubo[0], sizeof(commonubo[0]), 0);
+		uploadObject(DSBackground, currentImage, commonubo[0], commonTransforms[0]);
 		DSBackground.map(currentImage, &bgubo, sizeof(bgubo), 1);
 
 		// Matrix setup for walls
-		World = glm::mat4(1);
 		wallubo.amb = 1.2f; wallubo.sigma = 0.7f;
-		commonubo[1].mvpMat = Prj * View * World;
-		commonubo[1].mMat = World;
-		commonubo[1].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[1], commonTransforms[1], 0, [&] { return glm::mat4(1); });
 		commonubo[1].transparency = 0.0f;
 		commonubo[1].textureIdx = 0;
-		DSWall.map(currentImage, &commonubo[1], sizeof(commonubo[1]), 0);
+		uploadObject(DSWall, currentImage, commonubo[1], commonTransforms[1]);
 		DSWall.map(currentImage, &wallubo, sizeof(wallubo), 1);
 
 		// Matrix setup for floor
-		World = glm::mat4(1);
 		floorubo.amb = 1.2f; floorubo.sigma = 0.7f;
-		commonubo[3].mvpMat = Prj * View * World;
-		commonubo[3].mMat = World;
-		commonubo[3].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[3], commonTransforms[3], 0, [&] { return glm::mat4(1); });
 		commonubo[3].transparency = 0.0f;
 		commonubo[3].textureIdx = 0;
-		DSFloor.map(currentImage, &commonubo[3], sizeof(commonubo[3]), 0);
+		uploadObject(DSFloor, currentImage, commonubo[3], commonTransforms[3]);
 		DSFloor.map(currentImage, &floorubo, sizeof(floorubo), 1);
 
 		// Matrix setup for ceiling
-		World = glm::mat4(1);
 		ceilingubo.amb = 1.0f; ceilingubo.sigma = 0.7f;
-		commonubo[2].mvpMat = Prj * View * World;
-		commonubo[2].mMat = World;
-		commonubo[2].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[2], commonTransforms[2], 0, [&] { return glm::mat4(1); });
 		commonubo[2].transparency = 0.0f;
 		commonubo[2].textureIdx = 0;
-		DSCeiling.map(currentImage, &commonubo[2], sizeof(commonubo[2]), 0);
+		uploadObject(DSCeiling, currentImage, commonubo[2], commonTransforms[2]);
 		DSCeiling.map(currentImage, &ceilingubo, sizeof(ceilingubo), 1);
 
 		// Matrix setup for table
-		World = baseTranslation;
 		tableubo.amb = 25.0f; tableubo.sigma = 0.7f;
-		commonubo[4].mvpMat = Prj * View * World;
-		commonubo[4].mMat = World;
-		commonubo[4].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[4], commonTransforms[4], 0, [&] { return baseTranslation; });
 		commonubo[4].transparency = 0.0f;
 		commonubo[4].textureIdx = 0;
-		DSTable.map(currentImage, &commonubo[4], sizeof(commonubo[4]), 0);
+		uploadObject(DSTable, currentImage, commonubo[4], commonTransforms[4]);
 		DSTable.map(currentImage, &tableubo, sizeof(tableubo), 1);
 
 		// Matrix setup for windows
 		// Window 1
-		World = glm::translate(glm::mat4(1), glm::vec3(0.0f, 1.5f, -2.0f));
 		window1ubo.amb = 1.0f; window1ubo.sigma = 0.9f;
-		commonubo[5].mvpMat = Prj * View * World;
-		commonubo[5].mMat = World;
-		commonubo[5].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[5], commonTransforms[5], 0, [&] { return glm::translate(glm::mat4(1), glm::vec3(0.0f, 1.5f, -2.0f)); });
 		commonubo[5].transparency = 1.0f;
 		commonubo[6].textureIdx = 0;
-		DSWindow1.map(currentImage, &commonubo[5], sizeof(commonubo[5]), 0);
+		uploadObject(DSWindow1, currentImage, commonubo[5], commonTransforms[5]);
 		DSWindow1.map(currentImage, &window1ubo, sizeof(window1ubo), 1);
 		// Window 2
-		World = glm::translate(glm::mat4(1), glm::vec3(-1.0f, 1.5f, -2.0f));
 		window2ubo.amb = 1.0f; window2ubo.sigma = 0.9f;
-		commonubo[6].mvpMat = Prj * View * World;
-		commonubo[6].mMat = World;
-		commonubo[6].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[6], commonTransforms[6], 0, [&] { return glm::translate(glm::mat4(1), glm::vec3(-1.0f, 1.5f, -2.0f)); });
 		commonubo[6].transparency = 1.0f;
-		DSWindow2.map(currentImage, &commonubo[6], sizeof(commonubo[6]), 0);
+		uploadObject(DSWindow2, currentImage, commonubo[6], commonTransforms[6]);
 		DSWindow2.map(currentImage, &window2ubo, sizeof(window2ubo), 1);
 		// Window 3
-		World = glm::translate(glm::mat4(1), glm::vec3(1.0f, 1.5f, -2.0f));
 		window3ubo.amb = 1.0f; window3ubo.sigma = 0.9f;
-		commonubo[7].mvpMat = Prj * View * World;
-		commonubo[7].mMat = World;
-		commonubo[7].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[7], commonTransforms[7], 0, [&] { return glm::translate(glm::mat4(1), glm::vec3(1.0f, 1.5f, -2.0f)); });
 		commonubo[7].transparency = 1.0f;
 		commonubo[7].textureIdx = 0;
-		DSWindow3.map(currentImage, &commonubo[7], sizeof(commonubo[7]), 0);
+		uploadObject(DSWindow3, currentImage, commonubo[7], commonTransforms[7]);
 		DSWindow3.map(currentImage, &window3ubo, sizeof(window3ubo), 1);
 
 		// Matrix setup for landscape
-		World = glm::mat4(1);
-		glm::mat4 TransLandscape = glm::translate(glm::mat4(1), glm::vec3(0.0f,1.57f,-1.99f));
-		glm::mat4 ScaleLandscape = glm::scale(glm::mat4(1), glm::vec3(1.49f,0.75f,1.0f));
-		World = TransLandscape * ScaleLandscape;
-		commonubo[8].mvpMat = Prj * View * World;
-		commonubo[8].mMat = World;
-		commonubo[8].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[8], commonTransforms[8], 0, [&] {
+			glm::mat4 TransLandscape = glm::translate(glm::mat4(1), glm::vec3(0.0f,1.57f,-1.99f));
+			glm::mat4 ScaleLandscape = glm::scale(glm::mat4(1), glm::vec3(1.49f,0.75f,1.0f));
+			return TransLandscape * ScaleLandscape;
+		});
 		commonubo[8].transparency = 0.0f;
 		commonubo[8].textureIdx = landscapeTextureIdx;
 		commonubo[8].objectIdx = -1;
-		DSLandscape.map(currentImage, &commonubo[8], sizeof(commonubo[8]), 0);
+		uploadObject(DSLandscape, currentImage, commonubo[8], commonTransforms[8]);
 
 		// Lion statue
-		World = glm::translate(glm::mat4(1), glm::vec3(-1.4f, 0.0f, 1.2f)) *
+		placeObject(commonubo[24], commonTransforms[24], 0, [&] {
+			return glm::translate(glm::mat4(1), glm::vec3(-1.4f, 0.0f, 1.2f)) *
 				glm::rotate(glm::mat4(1), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
 				glm::scale(glm::mat4(1), glm::vec3(0.7));
-		commonubo[24].mvpMat = Prj * View * World;
-		commonubo[24].mMat = World;
-		commonubo[24].nMat = glm::inverse(glm::transpose(World));
+		});
 		commonubo[24].transparency = 0.0f;
 		commonubo[24].textureIdx = 0;
 		lionubo.amb = 1.0f; lionubo.gamma = 200.0f; lionubo.sColor = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -2174,16 +2343,15 @@ protected:
 			lionubo.amb = 1.0f; lionubo.gamma = 200.0f;
 		}
 		lionubo.sColor = generalSColor;
-		DSLion.map(currentImage, &commonubo[24], sizeof(commonubo[24]), 0);
+		uploadObject(DSLion, currentImage, commonubo[24], commonTransforms[24]);
 		DSLion.map(currentImage, &lionubo, sizeof(lionubo), 1);
 
 		// Picture frame 1
-		World = pictureFramePosition *
-			glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) * 
-			glm::scale(glm::mat4(1), glm::vec3(0.5)); 
-		commonubo[25].mvpMat = Prj * View * World; 
-		commonubo[25].mMat = World; 
-		commonubo[25].nMat = glm::inverse(glm::transpose(World)); 
+		placeObject(commonubo[25], commonTransforms[25], 0, [&] {
+			return pictureFramePosition *
+				glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.5));
+		});
 		commonubo[25].transparency = 0.0f; 
 		commonubo[25].textureIdx = 0; 
 		if (isNight) {
@@ -2193,30 +2361,28 @@ protected:
 			pictureFrameubo1.amb = 1.0f; pictureFrameubo1.gamma = 200.0f;
 		}
 		pictureFrameubo1.sColor = generalSColor;
-		DSPictureFrame1.map(currentImage, &commonubo[25], sizeof(commonubo[25]), 0);
+		uploadObject(DSPictureFrame1, currentImage, commonubo[25], commonTransforms[25]);
 		DSPictureFrame1.map(currentImage, &pictureFrameubo1, sizeof(pictureFrameubo1), 1);
 
 		// Picture frame Image 1
-		World = pictureFramePosition * glm::translate(glm::mat4(1), glm::vec3(0.0f, -0.26f, -0.015f)) *
-			glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.47f)) * glm::scale(glm::mat4(1), glm::vec3(1.0f, 1.2f, 1.0f)) * 
-			glm::scale(glm::mat4(1), glm::vec3(-1.0f, 1.0f, -1.0f));
-		commonubo[26].mvpMat = Prj * View * World;
-		commonubo[26].mMat = World;
-		commonubo[26].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[26], commonTransforms[26], 0, [&] {
+			return pictureFramePosition * glm::translate(glm::mat4(1), glm::vec3(0.0f, -0.26f, -0.015f)) *
+				glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.47f)) * glm::scale(glm::mat4(1), glm::vec3(1.0f, 1.2f, 1.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(-1.0f, 1.0f, -1.0f));
+		});
 		commonubo[26].transparency = 0.0f;
 		commonubo[26].textureIdx = pictureFrameImageIdx1;
 		pictureFrameImageubo1.amb = 20.0f; pictureFrameImageubo1.sigma = 1.1f;
-		DSPictureFrameImage1.map(currentImage, &commonubo[26], sizeof(commonubo[26]), 0);
+		uploadObject(DSPictureFrameImage1, currentImage, commonubo[26], commonTransforms[26]);
 		DSPictureFrameImage1.map(currentImage, &pictureFrameImageubo1, sizeof(pictureFrameImageubo1), 1);
 
 		// Picture frame 2
-		World = pictureFramePosition * glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.3f, -1.5f)) *
-			glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.5));
-		commonubo[29].mvpMat = Prj * View * World;
-		commonubo[29].mMat = World;
-		commonubo[29].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[29], commonTransforms[29], 0, [&] {
+			return pictureFramePosition * glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.3f, -1.5f)) *
+				glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.5));
+		});
 		commonubo[29].transparency = 0.0f;
 		commonubo[29].textureIdx = 0;
 		if (isNight) {
@@ -2226,31 +2392,29 @@ protected:
 			pictureFrameubo2.amb = 1.0f; pictureFrameubo2.gamma = 200.0f;
 		}
 		pictureFrameubo2.sColor = generalSColor;
-		DSPictureFrame2.map(currentImage, &commonubo[29], sizeof(commonubo[29]), 0);
+		uploadObject(DSPictureFrame2, currentImage, commonubo[29], commonTransforms[29]);
 		DSPictureFrame2.map(currentImage, &pictureFrameubo2, sizeof(pictureFrameubo2), 1);
 
 		// Picture frame Image 2
-		World = pictureFramePosition * glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.3f, -1.5f)) *
-			glm::translate(glm::mat4(1), glm::vec3(0.0f, -0.26f, -0.015f)) *
-			glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.47f)) * glm::scale(glm::mat4(1), glm::vec3(1.0f, 1.2f, 1.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(-1.0f, 1.0f, -1.0f));
-		commonubo[30].mvpMat = Prj * View * World;
-		commonubo[30].mMat = World;
-		commonubo[30].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[30], commonTransforms[30], 0, [&] {
+			return pictureFramePosition * glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.3f, -1.5f)) *
+				glm::translate(glm::mat4(1), glm::vec3(0.0f, -0.26f, -0.015f)) *
+				glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.47f)) * glm::scale(glm::mat4(1), glm::vec3(1.0f, 1.2f, 1.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(-1.0f, 1.0f, -1.0f));
+		});
 		commonubo[30].transparency = 0.0f;
 		commonubo[30].textureIdx = pictureFrameImageIdx2;
 		pictureFrameImageubo2.amb = 20.0f; pictureFrameImageubo2.sigma = 1.1f;
-		DSPictureFrameImage2.map(currentImage, &commonubo[30], sizeof(commonubo[30]), 0);
+		uploadObject(DSPictureFrameImage2, currentImage, commonubo[30], commonTransforms[30]);
 		DSPictureFrameImage2.map(currentImage, &pictureFrameImageubo2, sizeof(pictureFrameImageubo2), 1);
 
 		// Vase
-		World = glm::translate(glm::mat4(1), glm::vec3(1.5f, 0.0f, -1.8f)) *
-			glm::rotate(glm::mat4(1), glm::radians(60.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.016f));
-		commonubo[27].mvpMat = Prj * View * World;
-		commonubo[27].mMat = World;
-		commonubo[27].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[27], commonTransforms[27], 0, [&] {
+			return glm::translate(glm::mat4(1), glm::vec3(1.5f, 0.0f, -1.8f)) *
+				glm::rotate(glm::mat4(1), glm::radians(60.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.016f));
+		});
 		commonubo[27].transparency = 0.0f;
 		commonubo[27].textureIdx = 0;
 		if (isNight) {
@@ -2260,41 +2424,40 @@ protected:
 			vaseubo.amb = 1.0f; vaseubo.gamma = 200.0f;
 		}
 		vaseubo.sColor = generalSColor;
-		DSVase.map(currentImage, &commonubo[27], sizeof(commonubo[27]), 0);
+		uploadObject(DSVase, currentImage, commonubo[27], commonTransforms[27]);
 		DSVase.map(currentImage, &vaseubo, sizeof(vaseubo), 1);
 
 		// Chair
-		World = glm::translate(glm::mat4(1), glm::vec3(0.15f, -0.1f, 0.3f)) *
-			glm::rotate(glm::mat4(1), glm::radians(35.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.7f));
-		commonubo[28].mvpMat = Prj * View * World;
-		commonubo[28].mMat = World;
-		commonubo[28].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[28], commonTransforms[28], 0, [&] {
+			return glm::translate(glm::mat4(1), glm::vec3(0.15f, -0.1f, 0.3f)) *
+				glm::rotate(glm::mat4(1), glm::radians(35.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.7f));
+		});
 		commonubo[28].transparency = 0.0f;
 		commonubo[28].textureIdx = 0;
 		chairubo.amb = 20.0f; chairubo.sigma = 0.5f;
-		DSChair.map(currentImage, &commonubo[28], sizeof(commonubo[28]), 0);
+		uploadObject(DSChair, currentImage, commonubo[28], commonTransforms[28]);
 		DSChair.map(currentImage, &chairubo, sizeof(chairubo), 1);
 
 		// Door
-		World = glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.0f, 2.0f)) *
-			glm::rotate(glm::mat4(1), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(1.2f, 1.0f, 1.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.8f));
-		commonubo[37].mvpMat = Prj * View * World; 
-		commonubo[37].mMat = World;
-		commonubo[37].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[37], commonTransforms[37], 0, [&] {
+			return glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.0f, 2.0f)) *
+				glm::rotate(glm::mat4(1), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(1.2f, 1.0f, 1.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.8f));
+		});
 		commonubo[37].transparency = 0.0f;
 		commonubo[37].textureIdx = 0;
 		doorubo.amb = 20.0f; doorubo.sigma = 0.5f;
-		DSDoor.map(currentImage, &commonubo[37], sizeof(commonubo[37]), 0);
+		uploadObject(DSDoor, currentImage, commonubo[37], commonTransforms[37]);
 		DSDoor.map(currentImage, &doorubo, sizeof(doorubo), 1);
 
 
 		// Flame
 		std::mt19937 rngFlame(time(NULL));
 		std::uniform_int_distribution<int> genScaleDiff(8, 12);
-		float scaleDiff = genScaleDiff(rngFlame)/10.0f;
+		int scaleStep = genScaleDiff(rngFlame);
+		float scaleDiff = scaleStep/10.0f;
 		std::uniform_int_distribution<int> genRotDiff(0, 180);
 		float rotationDiff = genRotDiff(rngFlame);
 		std::uniform_int_distribution<int> genEmissionPicker(0, 3);
@@ -2307,30 +2470,33 @@ protected:
 		};
 		glm::vec3 chosenEmissionColor = emissionColors[emissionPicker];
 		std::uniform_int_distribution<int> genshearCoeff(-2, 2);
-		float shearhx = genshearCoeff(rngFlame)/10.0f;
-		float shearhz = genshearCoeff(rngFlame)/10.0f;
-		World = glm::translate(glm::mat4(1), candleLightPos) *
-			glm::rotate(glm::mat4(1), glm::radians(rotationDiff), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.16f)) *
-			glm::scale(glm::mat4(1), glm::vec3(float(isCandleAlight))) *
-			glm::scale(glm::mat4(1), glm::vec3(1.0f, scaleDiff, 1.0f)) *
-			glm::shearY3D(glm::mat4(1), shearhx, shearhz);
-		commonubo[31].mvpMat = Prj * View * World;
-		commonubo[31].mMat = World;
-		commonubo[31].nMat = glm::inverse(glm::transpose(World));
+		int shearStepX = genshearCoeff(rngFlame);
+		int shearStepZ = genshearCoeff(rngFlame);
+		float shearhx = shearStepX/10.0f;
+		float shearhz = shearStepZ/10.0f;
+		// the draws are seeded with the time in seconds, the flame changes at most once per second
+		uint64_t flameKey = (uint64_t)rotationDiff | (uint64_t)scaleStep << 8 | (uint64_t)(shearStepX + 2) << 12 |
+			(uint64_t)(shearStepZ + 2) << 16 | (uint64_t)isCandleAlight << 20;
+		placeObject(commonubo[31], commonTransforms[31], flameKey, [&] {
+			return glm::translate(glm::mat4(1), candleLightPos) *
+				glm::rotate(glm::mat4(1), glm::radians(rotationDiff), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.16f)) *
+				glm::scale(glm::mat4(1), glm::vec3(float(isCandleAlight))) *
+				glm::scale(glm::mat4(1), glm::vec3(1.0f, scaleDiff, 1.0f)) *
+				glm::shearY3D(glm::mat4(1), shearhx, shearhz);
+		});
 		commonubo[31].transparency = 0.0f;
 		commonubo[31].textureIdx = 0;
 		flameEmissionubo.emission = chosenEmissionColor;
-		DSFlame.map(currentImage, &commonubo[31], sizeof(commonubo[31]), 0);
+		uploadObject(DSFlame, currentImage, commonubo[31], commonTransforms[31]);
 		DSFlame.map(currentImage, &flameEmissionubo, sizeof(flameEmissionubo), 1);
 
 		// Candle
-		World = glm::translate(glm::mat4(1), candlePos) *
-			glm::rotate(glm::mat4(1), glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.055f));
-		commonubo[32].mvpMat = Prj * View * World;
-		commonubo[32].mMat = World;
-		commonubo[32].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[32], commonTransforms[32], 0, [&] {
+			return glm::translate(glm::mat4(1), candlePos) *
+				glm::rotate(glm::mat4(1), glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.055f));
+		});
 		commonubo[32].transparency = 0.0f;
 		commonubo[32].textureIdx = 0;
 		if (isNight) {
@@ -2342,16 +2508,15 @@ protected:
 		
 		if (isCandleAlight) candleubo.sColor = chosenEmissionColor;	// Change specular color according to emitted color by the candle light
 		else candleubo.sColor = glm::vec3(1.0f, 1.0f, 1.0f);
-		DSCandle.map(currentImage, &commonubo[32], sizeof(commonubo[32]), 0);
+		uploadObject(DSCandle, currentImage, commonubo[32], commonTransforms[32]);
 		DSCandle.map(currentImage, &candleubo, sizeof(candleubo), 1);
 
 		// Kettle
-		World = glm::translate(glm::mat4(1), glm::vec3(-0.4f, 0.6f, -0.5f)) *
-			glm::rotate(glm::mat4(1), glm::radians(235.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.4f));
-		commonubo[36].mvpMat = Prj * View * World;
-		commonubo[36].mMat = World;
-		commonubo[36].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[36], commonTransforms[36], 0, [&] {
+			return glm::translate(glm::mat4(1), glm::vec3(-0.4f, 0.6f, -0.5f)) *
+				glm::rotate(glm::mat4(1), glm::radians(235.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.4f));
+		});
 		commonubo[36].transparency = 0.0f;
 		commonubo[36].textureIdx = 0;
 		if (isNight) {
@@ -2361,16 +2526,15 @@ protected:
 			kettleubo.amb = 1.0f; kettleubo.gamma = 200.0f;
 		}
 		kettleubo.sColor = generalSColor;
-		DSKettle.map(currentImage, &commonubo[36], sizeof(commonubo[36]), 0);
+		uploadObject(DSKettle, currentImage, commonubo[36], commonTransforms[36]);
 		DSKettle.map(currentImage, &kettleubo, sizeof(kettleubo), 1);
 
 		// Blackboard
-		World = glm::translate(glm::mat4(1), glm::vec3(-2.0f, 1.3f, -0.5f)) *
-			glm::rotate(glm::mat4(1), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.008f));
-		commonubo[38].mvpMat = Prj * View * World;
-		commonubo[38].mMat = World;
-		commonubo[38].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[38], commonTransforms[38], 0, [&] {
+			return glm::translate(glm::mat4(1), glm::vec3(-2.0f, 1.3f, -0.5f)) *
+				glm::rotate(glm::mat4(1), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.008f));
+		});
 		commonubo[38].transparency = 0.0f;
 		commonubo[38].textureIdx = 0;
 		if (isNight) {
@@ -2380,11 +2544,13 @@ protected:
 			blackboardFrameubo.amb = 1.0f; blackboardFrameubo.gamma = 200.0f;
 		}
 		blackboardFrameubo.sColor = 0.2f*generalSColor;
-		DSBlackboardFrame.map(currentImage, &commonubo[38], sizeof(commonubo[38]), 0);
+		uploadObject(DSBlackboardFrame, currentImage, commonubo[38], commonTransforms[38]);
 		DSBlackboardFrame.map(currentImage, &blackboardFrameubo, sizeof(blackboardFrameubo), 1);
-		commonubo[39].mvpMat = Prj * View * World;
-		commonubo[39].mMat = World;
-		commonubo[39].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[39], commonTransforms[39], 0, [&] {
+			return glm::translate(glm::mat4(1), glm::vec3(-2.0f, 1.3f, -0.5f)) *
+				glm::rotate(glm::mat4(1), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.008f));
+		});
 		commonubo[39].transparency = 0.0f;
 		commonubo[39].textureIdx = 0;
 		if (isNight) {
@@ -2394,88 +2560,95 @@ protected:
 			blackboardBoardubo.amb = 1.0f; blackboardBoardubo.gamma = 200.0f;
 		}
 		blackboardBoardubo.sColor = generalSColor;
-		DSBlackboardBoard.map(currentImage, &commonubo[39], sizeof(commonubo[39]), 0);
+		uploadObject(DSBlackboardBoard, currentImage, commonubo[39], commonTransforms[39]);
 		DSBlackboardBoard.map(currentImage, &blackboardBoardubo, sizeof(blackboardBoardubo), 1);
 
 		// Blackboard text
-		World = glm::translate(glm::mat4(1), glm::vec3(-1.97f, 1.1f, -0.5f)) *
-			glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(0.54f)) *
-			glm::scale(glm::mat4(1), glm::vec3(1.6f, 1.0f, 1.0f));
-		commonubo[40].mvpMat = Prj * View * World;
-		commonubo[40].mMat = World;
-		commonubo[40].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[40], commonTransforms[40], 0, [&] {
+			return glm::translate(glm::mat4(1), glm::vec3(-1.97f, 1.1f, -0.5f)) *
+				glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(0.54f)) *
+				glm::scale(glm::mat4(1), glm::vec3(1.6f, 1.0f, 1.0f));
+		});
 		commonubo[40].transparency = 1.0f;
 		commonubo[40].textureIdx = 0;
 		blackboardTextubo.amb = 20.0f; blackboardTextubo.sigma = 1.3f;
-		DSBlackboardText.map(currentImage, &commonubo[40], sizeof(commonubo[40]), 0);
+		uploadObject(DSBlackboardText, currentImage, commonubo[40], commonTransforms[40]);
 		DSBlackboardText.map(currentImage, &blackboardTextubo, sizeof(blackboardTextubo), 1);
 
 		// Lamp
-		World = glm::translate(glm::mat4(1), glm::vec3(0.0f, 3.01f, 0.0f)) *
-			glm::rotate(glm::mat4(1), glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-			glm::scale(glm::mat4(1), glm::vec3(1.5f));
-		commonubo[35].mvpMat = Prj * View * World;
-		commonubo[35].mMat = World;
-		commonubo[35].nMat = glm::inverse(glm::transpose(World));
+		placeObject(commonubo[35], commonTransforms[35], 0, [&] {
+			return glm::translate(glm::mat4(1), glm::vec3(0.0f, 3.01f, 0.0f)) *
+				glm::rotate(glm::mat4(1), glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+				glm::scale(glm::mat4(1), glm::vec3(1.5f));
+		});
 		commonubo[35].transparency = 0.0f;
 		commonubo[35].textureIdx = lampTextureIdx;
 		if(isNight) lampubo.amb = 20.0f;
 		else lampubo.amb = 1000.0f;
 		lampubo.sigma = 0.3f;
-		DSLamp.map(currentImage, &commonubo[35], sizeof(commonubo[35]), 0);
+		uploadObject(DSLamp, currentImage, commonubo[35], commonTransforms[35]);
 		DSLamp.map(currentImage, &lampubo, sizeof(lampubo), 1);
 
-		// Matrix setup for tiles
-		for (int i = 0; i < 144; i++) {
-			float scaleFactor = game.tiles[i].isRemoved ? 0.0f : 1.0f;
-			glm::mat4 Tbase = baseTranslation * glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.6f, 0.0f));
-			glm::mat4 Tmat = glm::translate(glm::mat4(1), game.tiles[i].position * scaleFactor); // Matrix for translation
-			glm::mat4 Smat = glm::scale(glm::mat4(1), glm::vec3(scaleFactor));
-
-			World = Tbase * Tmat * Smat; // Translate tile in position
-
-			tileubo[i].amb = 1.0f; 
-			tileubo[i].gamma = 300.0f;
-			if(isNight) tileubo[i].sColor = generalSColor;
-			else tileubo[i].sColor =glm::vec3(0.5f);
-			tileubo[i].tileIdx = game.tiles[i].tileIdx;
-			tileubo[i].suitIdx = game.tiles[i].suitIdx;
-			tileubo[i].transparency = 1.0f;
-			tileubo[i].textureIdx = tileTextureIdx;
-			tileubo[i].isInMenu = 0;
-
-			// Highlight the piece on which the mouse is hoovering
-			tileubo[i].hoverIdx = hoverIndex;
-
-			// Highlight the first selected piece
-			if (i==firstTileIndex) {
-				tileubo[i].selectedIdx = firstTileIndex;
-			}
-			// Highlight the second selected piece
-			else if (i == secondTileIndex) {
-				tileubo[i].selectedIdx = secondTileIndex;
-			}
-			else {
-				tileubo[i].selectedIdx = -1;
+		// Values shared by the tiles, their matrices are built in Tile.vert
+		tileSharedubo.prjView = prjView;
+		tileSharedubo.boardWorld = baseTranslation * glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.6f, 0.0f));
+		tileSharedubo.amb = 1.0f;
+		tileSharedubo.gamma = 300.0f;
+		if (isNight) tileSharedubo.sColor = generalSColor;
+		else tileSharedubo.sColor = glm::vec3(0.5f);
+		tileSharedubo.fadingTransparency = DisappearingTileTransparency;
+		// Highlight the piece on which the mouse is hoovering
+		tileSharedubo.hoverIdx = hoverIndex;
+		tileSharedubo.textureIdx = tileTextureIdx;
+
+		// Record of a tile: position, suit and flags, marked for upload only if it changed
+		auto refreshTile = [&](int i) {
+			uint32_t flags = 0;
+			if (game.tiles[i].isRemoved) flags |= TILE_REMOVED;
+			// Highlight the selected pieces
+			if (i == firstTileIndex || i == secondTileIndex) flags |= TILE_SELECTED;
+			// Highlight the suggested pair
+			if (i == hintTileIndex0 || i == hintTileIndex1) flags |= TILE_HINT;
+			if ((gameState == 4 || gameState == 5) && (i == firstTileIndex || i == secondTileIndex)) flags |= TILE_FADING;
+			uint32_t suitAndFlags = (uint32_t)game.tiles[i].suitIdx | flags;
+			glm::vec3 position = game.layout->position(i);
+			if (tileubo[i].suitAndFlags == suitAndFlags && tileubo[i].position == position) return;
+			tileubo[i].position = position;
+			tileubo[i].suitAndFlags = suitAndFlags;
+			markTileDirty(i);
+		};
+		// Only the tiles removed or dealt again by the game, and the ones highlighted now or in the
+		// last frame, can have changed: the hovered tile is part of the shared block
+		game.takeChangedTiles(changedTiles);
+		for (int i : changedTiles) refreshTile(i);
+		for (int i : highlightedTiles) refreshTile(i);
+		highlightedTiles.clear();
+		for (int i : { firstTileIndex, secondTileIndex, hintTileIndex0, hintTileIndex1 }) {
+			if (i >= 0 && i < (int)game.tiles.size()) {
+				refreshTile(i);
+				highlightedTiles.push_back(i);
 			}
-			
-			tileubo[i].mvpMat = Prj * View * World; 
-			tileubo[i].mMat = World; 
-			tileubo[i].nMat = glm::inverse(glm::transpose(World)); 
-			if ((gameState == 4 || gameState == 5) && (i == firstTileIndex || i == secondTileIndex)) {
-				// Set transparency to DisappearingTileTransparency;
-				tileubo[i].transparency = DisappearingTileTransparency;	
+		}
+		// Write the records that changed to the buffer of this image, the other images get them on their turn
+		uint32_t imageBit = 1u << currentImage;
+		for (int i : dirtyTiles) {
+			if (tileDirtyImages[i] & imageBit) {
+				DSTiles.map(currentImage, &tileubo[i], sizeof(TileStorageBlock), 0, (int)(i * sizeof(TileStorageBlock)));
+				tileDirtyImages[i] &= ~imageBit;
 			}
-			DSTile[i].map(currentImage, &tileubo[i], sizeof(tileubo[i]), 0); 
 		}
+		dirtyTiles.erase(remove_if(dirtyTiles.begin(), dirtyTiles.end(), [&](int i) { return tileDirtyImages[i] == 0; }), dirtyTiles.end());
+		DSTiles.map(currentImage, &tileSharedubo, sizeof(tileSharedubo), 1);
 	}	
 };
 
 
 // This is the main: probably you do not need to touch this!
-int main() {
-	Mahjong app;
+int main(int argc, char* argv[]) {
+	// usage: mahjong [solvable|shuffle]
+	DealMode dealMode = (argc > 1 && string(argv[1]) == "shuffle") ? DEAL_RANDOM : DEAL_SOLVABLE;
+	Mahjong app(dealMode);
 
 	try {
 		app.run();
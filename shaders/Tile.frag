@@ -4,6 +4,7 @@
 layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec3 fragNorm;
 layout(location = 2) in vec2 fragUV;
+layout(location = 3) flat in int instance;
 
 layout(location = 0) out vec4 outColor;
 layout(location = 1) out int id;
@@ -17,25 +18,42 @@ layout(set = 0, binding = 0) uniform GlobalUniformBufferObject {
 	vec3 eyePos;		// position of the viewer
 } gubo;
 
-layout(set = 1, binding = 0) uniform UniformBufferObject {
+// Flags of a tile record, above the 16 bits of the suit
+const uint TILE_SELECTED = 1u << 17;
+const uint TILE_HINT = 1u << 18;
+const uint TILE_FADING = 1u << 19;
+const uint TILE_MENU = 1u << 20;
+
+struct TileBlock {
+	vec3 position;		// position on the board, relative to boardWorld
+	uint suitAndFlags;	// suit in the low 16 bits, flags above
+};
+
+// One block for each tile, the instance being drawn picks its own
+layout(std430, set = 1, binding = 0) readonly buffer TileBuffer {
+	TileBlock tiles[];
+};
+
+layout(set = 1, binding = 1) uniform TileSharedBufferObject {
+	mat4 prjView;
+	mat4 boardWorld;
+	mat4 menuWorld;
+	vec3 sColor;
 	float amb;
+	vec3 menuSColor;
+	float menuAmb;
 	float gamma;
-	vec3 sColor;
-	mat4 mvpMat;
-	mat4 mMat;
-	mat4 nMat;
-	int tileIdx;
-	int suitIdx;
-	float transparency;
+	float fadingTransparency;
 	int hoverIdx;
-	int selectedIdx;
 	int textureIdx;
-	int isInMenu; //1 if the tile is in the menu, 0 otherwise
-} ubo;
+} tileShared;
 
 layout(set = 2, binding = 0) uniform sampler2DArray tex;
 
 void main() {
+	TileBlock tile = tiles[instance];
+	float isInMenu = (tile.suitAndFlags & TILE_MENU) != 0u ? 1.0f : 0.0f;	// 1 if the tile is in the menu, 0 otherwise
+	int tileIdx = isInMenu > 0.5f ? -2 : instance;						// index of the tile on the board
 
 	vec3 N = normalize(fragNorm);								// surface normal
 	vec3 V = normalize(gubo.eyePos - fragPos);					// viewer direction
@@ -43,32 +61,33 @@ void main() {
 	vec3 H = normalize(L + V);									// half vector for Blinn BRDF
 	float intensityCoeff = clamp(pow((gubo.g/length(gubo.PlightPos - fragPos)), gubo.beta), 0.0f, 1.0f);
 	vec3 I = intensityCoeff * gubo.PlightColor;					// Light intensity
-	float alpha = ubo.transparency;								// transparency of the tile
+	float alpha = (tile.suitAndFlags & TILE_FADING) != 0u ? tileShared.fadingTransparency : 1.0f;	// transparency of the tile
 
-	I = (1-ubo.isInMenu)*I + ubo.isInMenu*vec3(1.0f);
+	I = (1-isInMenu)*I + isInMenu*vec3(1.0f);
 
-	vec3 albedo = texture(tex, vec3(fragUV, ubo.textureIdx)).rgb;
+	vec3 albedo = texture(tex, vec3(fragUV, tileShared.textureIdx)).rgb;
 	vec3 MD = albedo;
-	vec3 MS = ubo.sColor;
-	vec3 MA = albedo * ubo.amb;
+	vec3 MS = mix(tileShared.sColor, tileShared.menuSColor, isInMenu);
+	vec3 MA = albedo * mix(tileShared.amb, tileShared.menuAmb, isInMenu);
 	vec3 LA = gubo.AmbLightColor;
 	
 	vec3 Lambert = MD * clamp(dot(L,N),0.0f,1.0f);
-	vec3 Blinn = MS * pow(clamp(dot(N, H), 0.0f, 1.0f), ubo.gamma);
+	vec3 Blinn = MS * pow(clamp(dot(N, H), 0.0f, 1.0f), tileShared.gamma);
 	vec3 Ambient = LA * MA;
 
 	// Compute hover coefficient:
 	// Subtract the tile idx from the hover idx: only if they coincide, the subtraction will return 0
-	// Normalize the result to fit into the [-1,1] range (included the case in which mouse hovers on negative values)
-	// Compute absolute value. Values are now in the [0,1] range, 0 only if hoverIdx == tileIdx
-	// Compute ceiling: all non-zero values will become 1
-	// Invert to have 1 when hovering and 0 otherwise
-	float hoverCoeff = 1-ceil(abs((ubo.hoverIdx-ubo.tileIdx)/200.0f)); 
+	// Compute absolute value: 0 only if hoverIdx == tileIdx, at least 1 otherwise
+	// Clamp to 1: all non-zero values will become 1, whatever the number of tiles
+	// Invert to have 1 when hovering and 0 otherwise, the tile of the menu is never highlighted
+	float hoverCoeff = (1-isInMenu) * (1-min(abs(float(tileShared.hoverIdx-tileIdx)), 1.0f));
 	vec3 MHover = hoverCoeff * vec3(77.0f/255.0f, 77.0f/255.0f, 255.0f/255.0f);
-	// Similar procedure as for hover coefficient
-	float selectCoeff = 1-ceil(abs((ubo.selectedIdx - ubo.tileIdx)/200.0f));
+	// Selection and suggestion are flags of the tile
+	float selectCoeff = (tile.suitAndFlags & TILE_SELECTED) != 0u ? 1.0f : 0.0f;
 	vec3 MSelected = selectCoeff * 1.3f * vec3(255.0f/255.0f, 60.0f/255.0f, 59.0f/255.0f);
+	float hintCoeff = (tile.suitAndFlags & TILE_HINT) != 0u ? 1.0f : 0.0f;
+	vec3 MHint = hintCoeff * vec3(60.0f/255.0f, 200.0f/255.0f, 80.0f/255.0f);
 
-	outColor = vec4(clamp(I*Lambert + Blinn + Ambient + MHover + MSelected,0.0f, 0.95f), alpha);
-	id = ubo.tileIdx;
+	outColor = vec4(clamp(I*Lambert + Blinn + Ambient + MHover + MSelected + MHint,0.0f, 0.95f), alpha);
+	id = tileIdx;
 }
\ No newline at end of file
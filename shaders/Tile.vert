@@ -1,21 +1,33 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(set = 1, binding = 0) uniform UniformBufferObject {
+// Flags of a tile record, above the 16 bits of the suit
+const uint TILE_REMOVED = 1u << 16;
+const uint TILE_MENU = 1u << 20;
+
+struct TileBlock {
+	vec3 position;		// position on the board, relative to boardWorld
+	uint suitAndFlags;	// suit in the low 16 bits, flags above
+};
+
+// One block for each tile, the instance being drawn picks its own
+layout(std430, set = 1, binding = 0) readonly buffer TileBuffer {
+	TileBlock tiles[];
+};
+
+layout(set = 1, binding = 1) uniform TileSharedBufferObject {
+	mat4 prjView;
+	mat4 boardWorld;
+	mat4 menuWorld;
+	vec3 sColor;
 	float amb;
+	vec3 menuSColor;
+	float menuAmb;
 	float gamma;
-	vec3 sColor;
-	mat4 mvpMat;
-	mat4 mMat;
-	mat4 nMat;
-	int tileIdx;
-	int suitIdx;
-	float transparency;
+	float fadingTransparency;
 	int hoverIdx;
-	int selectedIdx;
 	int textureIdx;
-	int isInMenu;
-} ubo;
+} tileShared;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNorm;
@@ -24,10 +36,30 @@ layout(location = 2) in vec2 inUV;
 layout(location = 0) out vec3 fragPos;
 layout(location = 1) out vec3 fragNorm;
 layout(location = 2) out vec2 outUV;
+layout(location = 3) flat out int instance;
 
 void main() {
-	gl_Position = ubo.mvpMat * vec4(inPosition, 1.0);
-	fragPos = (ubo.mMat * vec4(inPosition, 1.0)).xyz;
-	fragNorm = (ubo.nMat * vec4(inNorm, 0.0)).xyz;
-	outUV = vec2((ubo.suitIdx % 10 + inUV.x)*0.1, (ubo.suitIdx /10 + inUV.y)  *0.2);
-}
\ No newline at end of file
+	TileBlock tile = tiles[gl_InstanceIndex];
+	instance = gl_InstanceIndex;
+	mat4 mMat;
+	if ((tile.suitAndFlags & TILE_MENU) != 0u) {
+		mMat = tileShared.menuWorld;
+	}
+	else {
+		// removed tiles are scaled to a point, nothing is rasterized
+		float scaleFactor = (tile.suitAndFlags & TILE_REMOVED) != 0u ? 0.0f : 1.0f;
+		mMat = tileShared.boardWorld;
+		mMat[3] += tileShared.boardWorld * vec4(tile.position * scaleFactor, 0.0);
+		mMat[0] *= scaleFactor;
+		mMat[1] *= scaleFactor;
+		mMat[2] *= scaleFactor;
+	}
+	// only the directions matter, the fragment shader normalizes: the scale of removed tiles is left out
+	mat3 nMat = transpose(inverse(mat3((tile.suitAndFlags & TILE_MENU) != 0u ? tileShared.menuWorld : tileShared.boardWorld)));
+	int suitIdx = int(tile.suitAndFlags & 0xFFFFu);
+	vec4 worldPos = mMat * vec4(inPosition, 1.0);
+	gl_Position = tileShared.prjView * worldPos;
+	fragPos = worldPos.xyz;
+	fragNorm = nMat * inNorm;
+	outUV = vec2((suitIdx % 10 + inUV.x)*0.1, (suitIdx /10 + inUV.y)  *0.2);
+}
@@ -0,0 +1,1606 @@
+#!/usr/bin/env python3
+# Compiles the shaders of this folder to SPIR-V 1.0 for Vulkan 1.0 without the Vulkan SDK:
+#
+#	python3 compile.py Tile.vert Tile.frag
+#
+# writes TileVert.spv and TileFrag.spv next to the sources. glslc builds equivalent files
+# (glslc Tile.vert -o TileVert.spv); this script only knows the part of GLSL 4.50 the shaders
+# here use, and stops with an error naming the line of anything else.
+import os
+import re
+import struct
+import sys
+
+GENERATOR = 0x00000001		# no registered tool id, version 1
+
+OP = dict(
+	Source=3, SourceExtension=4, Name=5, MemberName=6, ExtInstImport=11, ExtInst=12,
+	MemoryModel=14, EntryPoint=15, ExecutionMode=16, Capability=17,
+	TypeVoid=19, TypeBool=20, TypeInt=21, TypeFloat=22, TypeVector=23, TypeMatrix=24,
+	TypeImage=25, TypeSampledImage=27, TypeArray=28, TypeRuntimeArray=29,
+	TypeStruct=30, TypePointer=32, TypeFunction=33,
+	ConstantTrue=41, ConstantFalse=42, Constant=43, ConstantComposite=44,
+	Function=54, FunctionParameter=55, FunctionEnd=56, FunctionCall=57,
+	Variable=59, Load=61, Store=62, AccessChain=65, Decorate=71, MemberDecorate=72,
+	VectorShuffle=79, CompositeConstruct=80, CompositeExtract=81, Transpose=84,
+	ImageSampleImplicitLod=87, ImageSampleExplicitLod=88,
+	ConvertFToU=109, ConvertFToS=110, ConvertSToF=111, ConvertUToF=112, Bitcast=124,
+	SNegate=126, FNegate=127, IAdd=128, FAdd=129, ISub=130, FSub=131, IMul=132, FMul=133,
+	UDiv=134, SDiv=135, FDiv=136, UMod=137, SMod=139, FMod=141,
+	VectorTimesScalar=142, MatrixTimesScalar=143, VectorTimesMatrix=144, MatrixTimesVector=145,
+	MatrixTimesMatrix=146, Dot=148,
+	LogicalEqual=164, LogicalNotEqual=165, LogicalOr=166, LogicalAnd=167, LogicalNot=168, Select=169,
+	IEqual=170, INotEqual=171, UGreaterThan=172, SGreaterThan=173, UGreaterThanEqual=174,
+	SGreaterThanEqual=175, ULessThan=176, SLessThan=177, ULessThanEqual=178, SLessThanEqual=179,
+	FOrdEqual=180, FOrdNotEqual=182, FOrdLessThan=184, FOrdGreaterThan=186,
+	FOrdLessThanEqual=188, FOrdGreaterThanEqual=190,
+	ShiftRightLogical=194, ShiftRightArithmetic=195, ShiftLeftLogical=196,
+	BitwiseOr=197, BitwiseXor=198, BitwiseAnd=199, Not=200,
+	SelectionMerge=247, Label=248, Branch=249, BranchConditional=250,
+	Kill=252, Return=253, ReturnValue=254, Unreachable=255,
+)
+
+# GLSL.std.450 extended instructions
+GLSL = dict(
+	Round=1, Trunc=3, FAbs=4, SAbs=5, FSign=6, SSign=7, Floor=8, Ceil=9, Fract=10,
+	Radians=11, Degrees=12, Sin=13, Cos=14, Tan=15, Asin=16, Acos=17, Atan=18, Atan2=25,
+	Pow=26, Exp=27, Log=28, Exp2=29, Log2=30, Sqrt=31, InverseSqrt=32, Determinant=33,
+	MatrixInverse=34, FMin=37, UMin=38, SMin=39, FMax=40, UMax=41, SMax=42,
+	FClamp=43, UClamp=44, SClamp=45, FMix=46, Step=48, SmoothStep=49,
+	Length=66, Distance=67, Cross=68, Normalize=69, Reflect=71,
+)
+
+DECORATION = dict(Block=2, BufferBlock=3, ColMajor=5, ArrayStride=6, MatrixStride=7, BuiltIn=11,
+	Flat=14, NonWritable=24, Location=30, Binding=33, DescriptorSet=34, Offset=35)
+BUILTIN = dict(gl_Position=0, gl_VertexIndex=42, gl_InstanceIndex=43, gl_FragCoord=15)
+
+UNIFORM_CONSTANT, INPUT, UNIFORM, OUTPUT, FUNCTION = 0, 1, 2, 3, 7
+VERTEX, FRAGMENT = 0, 4
+
+
+class CompileError(Exception):
+	pass
+
+
+def words(s):
+	b = s.encode() + b'\0'
+	b += b'\0' * (-len(b) % 4)
+	return list(struct.unpack('<%dI' % (len(b) // 4), b))
+
+
+def f32(x):
+	return struct.unpack('<f', struct.pack('<f', x))[0]
+
+
+def f32bits(x):
+	return struct.unpack('<I', struct.pack('<f', x))[0]
+
+
+# Types
+
+class Type:
+	def __init__(self, kind, elem=None, n=0, name=None, members=None):
+		self.kind = kind		# void bool int uint float vec mat array struct sampler
+		self.elem = elem		# component, column or element type
+		self.n = n				# components, columns or elements, None for a runtime array
+		self.name = name
+		self.members = members	# list of (name, type) of a struct
+
+	def key(self):
+		if self.kind == 'struct':
+			return ('struct', id(self))
+		return (self.kind, self.elem.key() if self.elem else None, self.n, self.name)
+
+	def __eq__(self, other):
+		return isinstance(other, Type) and self.key() == other.key()
+
+	def __hash__(self):
+		return hash(self.key())
+
+	def scalar(self):
+		return self.kind in ('bool', 'int', 'uint', 'float')
+
+	def base(self):
+		# scalar kind of a scalar, vector or matrix
+		t = self
+		while not t.scalar():
+			if t.kind not in ('vec', 'mat'):
+				return None
+			t = t.elem
+		return t.kind
+
+	def size(self):
+		return 1 if self.scalar() else self.n
+
+	def __str__(self):
+		if self.kind == 'vec':
+			return {'float': '', 'int': 'i', 'uint': 'u', 'bool': 'b'}[self.elem.kind] + 'vec%d' % self.n
+		if self.kind == 'mat':
+			return 'mat%d' % self.n if self.n == self.elem.n else 'mat%dx%d' % (self.n, self.elem.n)
+		if self.kind == 'array':
+			return '%s[%s]' % (self.elem, '' if self.n is None else self.n)
+		if self.kind in ('struct', 'sampler'):
+			return self.name
+		return self.kind
+
+
+VOID, BOOL, INT, UINT, FLOAT = (Type(k) for k in ('void', 'bool', 'int', 'uint', 'float'))
+SCALAR = dict(bool=BOOL, int=INT, uint=UINT, float=FLOAT)
+
+
+def vec(base, n):
+	return base if n == 1 else Type('vec', base, n)
+
+
+def mat(cols, rows):
+	return Type('mat', vec(FLOAT, rows), cols)
+
+
+BUILTIN_TYPES = dict(void=VOID, bool=BOOL, int=INT, uint=UINT, float=FLOAT)
+for _n in (2, 3, 4):
+	for _p, _b in (('', FLOAT), ('i', INT), ('u', UINT), ('b', BOOL)):
+		BUILTIN_TYPES['%svec%d' % (_p, _n)] = vec(_b, _n)
+	BUILTIN_TYPES['mat%d' % _n] = mat(_n, _n)
+	for _r in (2, 3, 4):
+		BUILTIN_TYPES['mat%dx%d' % (_n, _r)] = mat(_n, _r)
+for _s, _dim, _arrayed in (('sampler2D', 1, 0), ('sampler2DArray', 1, 1), ('samplerCube', 3, 0)):
+	BUILTIN_TYPES[_s] = Type('sampler', n=(_dim, _arrayed), name=_s)
+
+
+def layout_of(t, packing):
+	# (alignment, size) of a type in a std140 or std430 block, matrices are column major
+	if t.scalar():
+		return 4, 4
+	if t.kind == 'vec':
+		return (8 if t.n == 2 else 16), 4 * t.n
+	if t.kind == 'mat':
+		stride = array_stride(t.elem, packing)
+		return max(stride, 16 if packing == 'std140' else 0), stride * t.n
+	if t.kind == 'array':
+		stride = array_stride(t.elem, packing)
+		return max(stride, 16 if packing == 'std140' else 0), stride * (t.n or 0)
+	if t.kind == 'struct':
+		align = max(layout_of(m, packing)[0] for _, m in t.members)
+		if packing == 'std140':
+			align = max(align, 16)
+		offsets = member_offsets(t, packing)
+		end = offsets[-1] + layout_of(t.members[-1][1], packing)[1]
+		return align, -(-end // align) * align
+	raise CompileError('%s cannot be placed in a buffer' % t)
+
+
+def array_stride(t, packing):
+	align, size = layout_of(t, packing)
+	stride = -(-size // align) * align
+	return -(-stride // 16) * 16 if packing == 'std140' else stride
+
+
+def member_offsets(t, packing):
+	offsets, at = [], 0
+	for _, m in t.members:
+		align, size = layout_of(m, packing)
+		at = -(-at // align) * align
+		offsets.append(at)
+		at += size
+	return offsets
+
+
+# Source text
+
+TOKEN = re.compile(r'''
+	(?P<space>\s+)
+	| (?P<float>(?:\d+\.\d*|\.\d+)(?:[eE][-+]?\d+)?[fF]? | \d+[eE][-+]?\d+[fF]? | \d+[fF])
+	| (?P<int>0[xX][0-9a-fA-F]+[uU]? | \d+[uU]?)
+	| (?P<ident>[A-Za-z_]\w*)
+	| (?P<op><<=|>>=|<<|>>|\+\+|--|&&|\|\||[-+*/%&|^=!<>]=|[-+*/%&|^=!<>~?:;,.(){}\[\]])
+''', re.X)
+
+
+class Token:
+	def __init__(self, kind, text, line):
+		self.kind, self.text, self.line = kind, text, line
+
+
+def strip_comments(src):
+	# comments become blanks, newlines are kept for the line numbers
+	def blank(m):
+		return re.sub(r'[^\n]', ' ', m.group(0))
+	return re.sub(r'//[^\n]*|/\*.*?\*/', blank, src, flags=re.S)
+
+
+def tokenize(src):
+	version, extensions, tokens = None, [], []
+	for number, text in enumerate(strip_comments(src).split('\n'), 1):
+		if text.strip().startswith('#'):
+			directive = text.split()
+			if directive[0] == '#version' and len(directive) >= 2:
+				version = int(directive[1])
+			elif directive[0] == '#extension' and len(directive) >= 2:
+				extensions.append(directive[1])
+			else:
+				raise CompileError('line %d: unsupported directive %s' % (number, directive[0]))
+			continue
+		at = 0
+		while at < len(text):
+			m = TOKEN.match(text, at)
+			if not m:
+				raise CompileError('line %d: unexpected character %r' % (number, text[at]))
+			if m.lastgroup != 'space':
+				tokens.append(Token(m.lastgroup, m.group(0), number))
+			at = m.end()
+	if version != 450:
+		raise CompileError('only #version 450 shaders are supported')
+	tokens.append(Token('end', '', number))
+	return extensions, tokens
+
+
+# Syntax tree
+
+class Node:
+	def __init__(self, kind, line, *args):
+		self.kind, self.line, self.args = kind, line, args
+
+	def effects(self):
+		# assignments and user function calls cannot be evaluated speculatively
+		if self.kind == 'assign' or self.kind == 'call' and self.args[2]:
+			return True
+		return any(a.effects() for a in self.children())
+
+	def children(self):
+		for a in self.args:
+			if isinstance(a, Node):
+				yield a
+			elif isinstance(a, list):
+				for b in a:
+					if isinstance(b, Node):
+						yield b
+
+
+class Declaration:
+	def __init__(self, line, qualifiers, layout, type, name, init=None, block=None):
+		self.line, self.qualifiers, self.layout = line, qualifiers, layout
+		self.type, self.name, self.init, self.block = type, name, init, block
+
+
+QUALIFIERS = ('const', 'in', 'out', 'inout', 'uniform', 'buffer', 'flat', 'smooth', 'noperspective',
+	'readonly', 'writeonly', 'highp', 'mediump', 'lowp')
+
+BINARY = [('||',), ('^^',), ('&&',), ('|',), ('^',), ('&',), ('==', '!='), ('<', '>', '<=', '>='),
+	('<<', '>>'), ('+', '-'), ('*', '/', '%')]
+
+
+class Parser:
+	def __init__(self, tokens):
+		self.tokens, self.at = tokens, 0
+		self.types = dict(BUILTIN_TYPES)
+		self.functions = set()
+
+	def peek(self, offset=0):
+		return self.tokens[min(self.at + offset, len(self.tokens) - 1)]
+
+	def next(self):
+		t = self.peek()
+		self.at += 1
+		return t
+
+	def error(self, message, token=None):
+		token = token or self.peek()
+		return CompileError('line %d: %s' % (token.line, message))
+
+	def accept(self, text):
+		if self.peek().text == text and self.peek().kind in ('op', 'ident'):
+			return self.next()
+		return None
+
+	def expect(self, text):
+		if not self.accept(text):
+			raise self.error('expected %r, found %r' % (text, self.peek().text or 'end of file'))
+
+	def ident(self):
+		t = self.next()
+		if t.kind != 'ident':
+			raise self.error('expected a name, found %r' % t.text, t)
+		return t.text
+
+	def is_type(self, offset=0):
+		t = self.peek(offset)
+		return t.kind == 'ident' and t.text in self.types
+
+	def type(self):
+		name = self.ident()
+		if name not in self.types:
+			raise self.error('unknown type %s' % name)
+		return self.types[name]
+
+	def array_suffix(self, t):
+		# name[N] or name[] for a runtime array at the end of a buffer
+		while self.accept('['):
+			if self.accept(']'):
+				t = Type('array', t, None)
+				continue
+			size = self.expression()
+			if size.kind != 'number' or size.args[1] not in ('int', 'uint'):
+				raise self.error('array sizes must be integer literals')
+			self.expect(']')
+			t = Type('array', t, size.args[0])
+		return t
+
+	# declarations
+
+	def unit(self):
+		globals = []
+		while self.peek().kind != 'end':
+			globals.extend(self.external())
+		return globals
+
+	def layout(self):
+		layout = {}
+		while self.accept('layout'):
+			self.expect('(')
+			while True:
+				key = self.ident()
+				layout[key] = None
+				if self.accept('='):
+					t = self.next()
+					if t.kind != 'int':
+						raise self.error('layout values must be integers', t)
+					layout[key] = int(t.text.rstrip('uU'), 0)
+				if not self.accept(','):
+					break
+			self.expect(')')
+		return layout
+
+	def qualifiers(self):
+		found = []
+		while self.peek().kind == 'ident' and self.peek().text in QUALIFIERS:
+			found.append(self.next().text)
+		return found
+
+	def members(self):
+		members = []
+		self.expect('{')
+		while not self.accept('}'):
+			line = self.peek().line
+			if self.layout() or self.qualifiers():
+				raise self.error('qualifiers of single members are not supported')
+			t = self.type()
+			while True:
+				name = self.ident()
+				members.append((name, self.array_suffix(t)))
+				if not self.accept(','):
+					break
+			self.expect(';')
+		if not members:
+			raise CompileError('line %d: empty struct or block' % line)
+		return members
+
+	def external(self):
+		line = self.peek().line
+		if self.accept('struct'):
+			name = self.ident()
+			t = Type('struct', name=name, members=self.members())
+			self.types[name] = t
+			self.expect(';')
+			return []
+		layout = self.layout()
+		qualifiers = self.qualifiers()
+		if ('uniform' in qualifiers or 'buffer' in qualifiers) and self.peek(1).text == '{':
+			name = self.ident()
+			block = Type('struct', name=name, members=self.members())
+			instance = None
+			if self.peek().kind == 'ident':
+				instance = self.ident()
+			self.expect(';')
+			return [Declaration(line, qualifiers, layout, block, instance, block=True)]
+		t = self.type()
+		name = self.ident()
+		if self.peek().text == '(':
+			if layout or qualifiers:
+				raise self.error('qualified functions are not supported')
+			return [self.function(line, t, name)]
+		return self.declarators(line, qualifiers, layout, t, name)
+
+	def declarators(self, line, qualifiers, layout, t, name):
+		found = []
+		while True:
+			declared = self.array_suffix(t)
+			init = self.assignment() if self.accept('=') else None
+			found.append(Declaration(line, qualifiers, layout, declared, name, init))
+			if not self.accept(','):
+				break
+			name = self.ident()
+		self.expect(';')
+		return found
+
+	def function(self, line, t, name):
+		self.expect('(')
+		params = []
+		if not self.accept(')'):
+			if self.peek().text == 'void' and self.peek(1).text == ')':
+				self.next()
+			else:
+				while True:
+					qualifiers = self.qualifiers()
+					if set(qualifiers) - {'in', 'const'}:
+						raise self.error('out and inout parameters are not supported')
+					pt = self.type()
+					params.append((self.ident(), pt))
+					if not self.accept(','):
+						break
+			self.expect(')')
+		self.functions.add(name)
+		if self.accept(';'):
+			raise self.error('function prototypes are not supported')
+		return Declaration(line, [], {}, t, name, (params, self.block()))
+
+	# statements
+
+	def block(self):
+		line = self.peek().line
+		self.expect('{')
+		statements = []
+		while not self.accept('}'):
+			statements.append(self.statement())
+		return Node('block', line, statements)
+
+	def statement(self):
+		t = self.peek()
+		if t.text == '{':
+			return self.block()
+		if self.accept('if'):
+			self.expect('(')
+			condition = self.expression()
+			self.expect(')')
+			then = self.statement()
+			otherwise = self.statement() if self.accept('else') else None
+			return Node('if', t.line, condition, then, otherwise)
+		if self.accept('return'):
+			value = None if self.peek().text == ';' else self.expression()
+			self.expect(';')
+			return Node('return', t.line, value)
+		if self.accept('discard'):
+			self.expect(';')
+			return Node('discard', t.line)
+		if t.text in ('for', 'while', 'do', 'switch', 'break', 'continue'):
+			raise self.error('%s is not supported' % t.text)
+		if t.text == 'const' or self.is_type() and self.peek(1).kind == 'ident':
+			qualifiers = self.qualifiers()
+			ty = self.type()
+			return Node('declare', t.line, self.declarators(t.line, qualifiers, {}, ty, self.ident()))
+		e = self.expression()
+		self.expect(';')
+		return Node('expression', t.line, e)
+
+	# expressions
+
+	def expression(self):
+		e = self.assignment()
+		if self.peek().text == ',':
+			raise self.error('the comma operator is not supported')
+		return e
+
+	def assignment(self):
+		line = self.peek().line
+		lhs = self.conditional()
+		t = self.peek()
+		if t.kind == 'op' and t.text in ('=', '+=', '-=', '*=', '/=', '%=', '&=', '|=', '^=', '<<=', '>>='):
+			self.next()
+			return Node('assign', line, t.text, lhs, self.assignment())
+		return lhs
+
+	def conditional(self):
+		line = self.peek().line
+		condition = self.binary(0)
+		if self.accept('?'):
+			a = self.assignment()
+			self.expect(':')
+			b = self.assignment()
+			return Node('select', line, condition, a, b)
+		return condition
+
+	def binary(self, level):
+		if level == len(BINARY):
+			return self.unary()
+		e = self.binary(level + 1)
+		while self.peek().kind == 'op' and self.peek().text in BINARY[level]:
+			t = self.next()
+			e = Node('binary', t.line, t.text, e, self.binary(level + 1))
+		return e
+
+	def unary(self):
+		t = self.peek()
+		if t.kind == 'op' and t.text in ('-', '+', '!', '~'):
+			self.next()
+			return Node('unary', t.line, t.text, self.unary())
+		if t.kind == 'op' and t.text in ('++', '--'):
+			raise self.error('%s is not supported' % t.text)
+		return self.postfix()
+
+	def postfix(self):
+		e = self.primary()
+		while True:
+			t = self.peek()
+			if self.accept('['):
+				e = Node('index', t.line, e, self.expression())
+				self.expect(']')
+			elif self.accept('.'):
+				e = Node('field', t.line, e, self.ident())
+			elif t.kind == 'op' and t.text in ('++', '--'):
+				raise self.error('%s is not supported' % t.text)
+			else:
+				return e
+
+	def primary(self):
+		t = self.next()
+		if t.kind == 'float':
+			return Node('number', t.line, f32(float(t.text.rstrip('fF'))), 'float')
+		if t.kind == 'int':
+			text = t.text.rstrip('uU')
+			value = int(text, 16) if text[:2] in ('0x', '0X') else int(text, 8) if len(text) > 1 and text[0] == '0' else int(text)
+			return Node('number', t.line, value, 'uint' if t.text[-1] in 'uU' else 'int')
+		if t.text in ('true', 'false'):
+			return Node('number', t.line, t.text == 'true', 'bool')
+		if t.text == '(':
+			e = self.expression()
+			self.expect(')')
+			return e
+		if t.kind == 'ident':
+			if self.accept('('):
+				args = []
+				if not self.accept(')'):
+					if self.peek().text == 'void' and self.peek(1).text == ')':
+						self.next()
+					else:
+						while True:
+							args.append(self.assignment())
+							if not self.accept(','):
+								break
+					self.expect(')')
+				return Node('call', t.line, t.text, args, t.text in self.functions)
+			return Node('name', t.line, t.text)
+		raise self.error('unexpected %r' % (t.text or 'end of file'), t)
+
+
+# Code generation
+
+class Value:
+	"""An rvalue: a result id, or a scalar or vector constant not emitted yet"""
+
+	def __init__(self, type, id=None, const=None):
+		self.type, self.id, self.const = type, id, const
+
+
+class Ref:
+	"""An lvalue: a variable and the access chain into it"""
+
+	def __init__(self, type, var, chain, storage, packing=None, readonly=False, name=None):
+		self.type, self.var, self.chain, self.storage = type, var, chain, storage
+		self.packing, self.readonly, self.name = packing, readonly, name
+
+	def member(self, type, index):
+		return Ref(type, self.var, self.chain + [index], self.storage, self.packing, self.readonly, self.name)
+
+
+class Symbol:
+	def __init__(self, ref=None, value=None):
+		self.ref, self.value = ref, value
+
+
+class Function:
+	def __init__(self, id, type, params, node, name):
+		self.id, self.type, self.params, self.node, self.name = id, type, params, node, name
+
+
+class Compiler:
+	def __init__(self, stage, extensions, types):
+		self.stage = stage
+		self.extensions = extensions
+		self.types = types
+		self.bound = 1
+		self.names, self.annotations, self.globals, self.code, self.function_code = [], [], [], [], []
+		self.cache = {}
+		self.interface = []
+		self.scopes = [{}]
+		self.functions = {}
+		self.glsl = self.new_id()
+		self.block = None	# label of the block being written, None after a terminator
+
+	def new_id(self):
+		r = self.bound
+		self.bound += 1
+		return r
+
+	@staticmethod
+	def inst(op, *operands):
+		ws = []
+		for o in operands:
+			ws.extend(o if isinstance(o, (list, tuple)) else [o])
+		return [((len(ws) + 1) << 16) | OP[op]] + ws
+
+	def name(self, target, name):
+		self.names.append(self.inst('Name', target, words(name)))
+
+	def decorate(self, target, decoration, *args):
+		self.annotations.append(self.inst('Decorate', target, DECORATION[decoration], list(args)))
+
+	def decorate_member(self, target, member, decoration, *args):
+		self.annotations.append(self.inst('MemberDecorate', target, member, DECORATION[decoration], list(args)))
+
+	def unique(self, key, op, *operands, result_type=None):
+		# types and constants are declared once
+		if key in self.cache:
+			return self.cache[key]
+		r = self.new_id()
+		if result_type is None:
+			self.globals.append(self.inst(op, r, *operands))
+		else:
+			self.globals.append(self.inst(op, result_type, r, *operands))
+		self.cache[key] = r
+		return r
+
+	# types
+
+	def tid(self, t, packing=None):
+		if t.kind == 'void':
+			return self.unique(('void',), 'TypeVoid')
+		if t.kind == 'bool':
+			return self.unique(('bool',), 'TypeBool')
+		if t.kind in ('int', 'uint'):
+			return self.unique((t.kind,), 'TypeInt', 32, 1 if t.kind == 'int' else 0)
+		if t.kind == 'float':
+			return self.unique(('float',), 'TypeFloat', 32)
+		if t.kind == 'vec':
+			return self.unique(('vec', t.key()), 'TypeVector', self.tid(t.elem), t.n)
+		if t.kind == 'mat':
+			return self.unique(('mat', t.key()), 'TypeMatrix', self.tid(t.elem), t.n)
+		if t.kind == 'sampler':
+			dim, arrayed = t.n
+			image = self.unique(('image', dim, arrayed), 'TypeImage', self.tid(FLOAT), dim, 0, arrayed, 0, 1, 0)
+			return self.unique(('sampler', dim, arrayed), 'TypeSampledImage', image)
+		key = (t.key(), packing)
+		if key in self.cache:
+			return self.cache[key]
+		if t.kind == 'array':
+			elem = self.tid(t.elem, packing)
+			if t.n is None:
+				r = self.unique(key, 'TypeRuntimeArray', elem)
+			else:
+				r = self.unique(key, 'TypeArray', elem, self.constant(UINT, t.n))
+			if packing:
+				self.decorate(r, 'ArrayStride', array_stride(t.elem, packing))
+			return r
+		if t.kind == 'struct':
+			members = [self.tid(m, packing) for _, m in t.members]
+			r = self.unique(key, 'TypeStruct', members)
+			self.name(r, t.name)
+			for i, (n, _) in enumerate(t.members):
+				self.names.append(self.inst('MemberName', r, i, words(n)))
+			if packing:
+				self.decorate_struct(r, t, packing)
+			return r
+		raise CompileError('no SPIR-V type for %s' % t)
+
+	def decorate_struct(self, r, t, packing):
+		for i, ((_, m), offset) in enumerate(zip(t.members, member_offsets(t, packing))):
+			inner = m
+			while inner.kind == 'array':
+				inner = inner.elem
+			if inner.kind == 'mat':
+				self.decorate_member(r, i, 'ColMajor')
+			self.decorate_member(r, i, 'Offset', offset)
+			if inner.kind == 'mat':
+				self.decorate_member(r, i, 'MatrixStride', array_stride(inner.elem, packing))
+
+	def pointer(self, storage, t, packing=None):
+		target = self.tid(t, packing)
+		return self.unique(('pointer', storage, target), 'TypePointer', storage, target)
+
+	# constants
+
+	def constant(self, t, value):
+		if t.kind == 'bool':
+			return self.unique(('constant', 'bool', value), 'ConstantTrue' if value else 'ConstantFalse',
+				result_type=self.tid(BOOL))
+		if t.kind == 'float':
+			return self.unique(('constant', 'float', f32bits(value)), 'Constant', f32bits(value),
+				result_type=self.tid(FLOAT))
+		if t.kind in ('int', 'uint'):
+			return self.unique(('constant', t.kind, value & 0xffffffff), 'Constant', value & 0xffffffff,
+				result_type=self.tid(t))
+		parts = [self.constant(t.elem, v) for v in value]
+		return self.unique(('constant', t.key(), tuple(parts)), 'ConstantComposite', parts, result_type=self.tid(t))
+
+	def id_of(self, v):
+		if v.id is None:
+			v.id = self.constant(v.type, v.const)
+		return v.id
+
+	# code
+
+	def op(self, op, t, *operands):
+		r = self.new_id()
+		self.emit(op, self.tid(t), r, *operands)
+		return Value(t, r)
+
+	def emit(self, op, *operands):
+		if self.block is None:
+			# code after return or discard lands in a block nothing branches to
+			self.label()
+		self.code.append(self.inst(op, *operands))
+		if op in ('Branch', 'BranchConditional', 'Return', 'ReturnValue', 'Kill', 'Unreachable'):
+			self.block = None
+
+	def ext(self, t, name, *args):
+		return self.op('ExtInst', t, self.glsl, GLSL[name], [self.id_of(a) for a in args])
+
+	def label(self, r=None):
+		r = r or self.new_id()
+		self.code.append(self.inst('Label', r))
+		self.block = r
+		return r
+
+	def error(self, node, message):
+		return CompileError('line %d: %s' % (node.line, message))
+
+	# symbols
+
+	def lookup(self, node, name):
+		for scope in reversed(self.scopes):
+			if name in scope:
+				return scope[name]
+		if name in BUILTIN:
+			return self.builtin(node, name)
+		raise self.error(node, 'unknown name %s' % name)
+
+	def declare(self, node, name, symbol):
+		if name in self.scopes[-1]:
+			raise self.error(node, '%s is already declared' % name)
+		self.scopes[-1][name] = symbol
+
+	def builtin(self, node, name):
+		if name == 'gl_Position':
+			if self.stage != VERTEX:
+				raise self.error(node, 'gl_Position is only written by vertex shaders')
+			# gl_PerVertex is the block of the vertex outputs, only its position is declared
+			block = Type('struct', name='gl_PerVertex', members=[('gl_Position', vec(FLOAT, 4))])
+			r = self.unique(('gl_PerVertex',), 'TypeStruct', self.tid(vec(FLOAT, 4)))
+			self.name(r, 'gl_PerVertex')
+			self.names.append(self.inst('MemberName', r, 0, words('gl_Position')))
+			self.decorate_member(r, 0, 'BuiltIn', BUILTIN[name])
+			self.decorate(r, 'Block')
+			var = self.variable(self.unique(('pointer', OUTPUT, r), 'TypePointer', OUTPUT, r), OUTPUT, '')
+			self.interface.append(var)
+			symbol = Symbol(Ref(block.members[0][1], var, [self.constant(INT, 0)], OUTPUT, name=name))
+		else:
+			t = vec(FLOAT, 4) if name == 'gl_FragCoord' else INT
+			if (name == 'gl_FragCoord') != (self.stage == FRAGMENT):
+				raise self.error(node, '%s is not available in this stage' % name)
+			var = self.variable(self.pointer(INPUT, t), INPUT, name)
+			self.decorate(var, 'BuiltIn', BUILTIN[name])
+			self.interface.append(var)
+			symbol = Symbol(Ref(t, var, [], INPUT, readonly=True, name=name))
+		self.scopes[0][name] = symbol
+		return symbol
+
+	def variable(self, pointer, storage, name):
+		r = self.new_id()
+		self.globals.append(self.inst('Variable', pointer, r, storage))
+		if name:
+			self.name(r, name)
+		return r
+
+	def local(self, t, name):
+		r = self.new_id()
+		self.locals.append(self.inst('Variable', self.pointer(FUNCTION, t), r, FUNCTION))
+		self.name(r, name)
+		return Ref(t, r, [], FUNCTION, name=name)
+
+	# globals
+
+	def compile(self, declarations):
+		for d in declarations:
+			if d.init is not None and isinstance(d.init, tuple):
+				self.function_declaration(d)
+			elif d.block:
+				self.block_declaration(d)
+			else:
+				self.global_declaration(d)
+		if 'main' not in self.functions:
+			raise CompileError('no main function')
+		for f in self.functions.values():
+			self.function_body(f)
+		return self.module()
+
+	def global_declaration(self, d):
+		q = set(d.qualifiers) - {'highp', 'mediump', 'lowp', 'smooth'}
+		if 'const' in q:
+			if q != {'const'} or d.init is None:
+				raise CompileError('line %d: constants need a value' % d.line)
+			value = self.convert(d.init, self.expression(d.init), d.type)
+			if value.const is None:
+				raise CompileError('line %d: %s is not a constant expression' % (d.line, d.name))
+			self.declare(d, d.name, Symbol(value=value))
+			return
+		if d.init is not None:
+			raise CompileError('line %d: only constants can be initialized outside of functions' % d.line)
+		if 'uniform' in q:
+			if d.type.kind != 'sampler' or q != {'uniform'}:
+				raise CompileError('line %d: uniforms other than samplers must be in a block' % d.line)
+			var = self.variable(self.pointer(UNIFORM_CONSTANT, d.type), UNIFORM_CONSTANT, d.name)
+			self.resource(d, var)
+			self.declare(d, d.name, Symbol(Ref(d.type, var, [], UNIFORM_CONSTANT, readonly=True, name=d.name)))
+			return
+		if 'in' in q or 'out' in q:
+			storage = INPUT if 'in' in q else OUTPUT
+			if q - {'in', 'out', 'flat', 'noperspective'} or 'location' not in d.layout:
+				raise CompileError('line %d: shader inputs and outputs need a location' % d.line)
+			if d.type.kind not in ('int', 'uint', 'float', 'vec', 'mat'):
+				raise CompileError('line %d: %s cannot be a shader input or output' % (d.line, d.type))
+			var = self.variable(self.pointer(storage, d.type), storage, d.name)
+			if d.type.base() != 'float' and self.stage == FRAGMENT and storage == INPUT and 'flat' not in q:
+				raise CompileError('line %d: integer fragment inputs must be flat' % d.line)
+			if 'flat' in q:
+				self.decorate(var, 'Flat')
+			self.decorate(var, 'Location', d.layout['location'])
+			self.interface.append(var)
+			self.declare(d, d.name, Symbol(Ref(d.type, var, [], storage, readonly=storage == INPUT, name=d.name)))
+			return
+		raise CompileError('line %d: global variables must be inputs, outputs, uniforms or constants' % d.line)
+
+	def resource(self, d, var):
+		if 'set' not in d.layout or 'binding' not in d.layout:
+			raise CompileError('line %d: resources need a set and a binding' % d.line)
+		self.decorate(var, 'DescriptorSet', d.layout['set'])
+		self.decorate(var, 'Binding', d.layout['binding'])
+
+	def block_declaration(self, d):
+		q = set(d.qualifiers)
+		buffer = 'buffer' in q
+		if q - {'uniform', 'buffer', 'readonly'} or 'readonly' in q and not buffer:
+			raise CompileError('line %d: unsupported block qualifiers' % d.line)
+		if buffer and 'readonly' not in q:
+			raise CompileError('line %d: only readonly buffers are supported' % d.line)
+		packing = 'std430' if buffer and 'std140' not in d.layout else 'std140'
+		if 'std430' in d.layout and not buffer:
+			raise CompileError('line %d: uniform blocks are std140' % d.line)
+		for i, (_, m) in enumerate(d.type.members):
+			if m.kind == 'array' and m.n is None and (i + 1 < len(d.type.members) or not buffer):
+				raise CompileError('line %d: only the last member of a buffer can be a runtime array' % d.line)
+		r = self.tid(d.type, packing)
+		self.decorate(r, 'BufferBlock' if buffer else 'Block')
+		if buffer:
+			for i in range(len(d.type.members)):
+				self.decorate_member(r, i, 'NonWritable')
+		var = self.variable(self.unique(('pointer', UNIFORM, r), 'TypePointer', UNIFORM, r), UNIFORM, d.name or '')
+		self.resource(d, var)
+		ref = Ref(d.type, var, [], UNIFORM, packing, True, d.name or d.type.name)
+		if d.name:
+			self.declare(d, d.name, Symbol(ref))
+		else:
+			# members of an unnamed block are names of their own
+			for i, (n, m) in enumerate(d.type.members):
+				self.declare(d, n, Symbol(ref.member(m, self.constant(INT, i))))
+
+	def function_declaration(self, d):
+		params, body = d.init
+		if d.name in self.functions or d.name in BUILTIN_TYPES:
+			raise CompileError('line %d: %s is already declared' % (d.line, d.name))
+		if d.name == 'main' and (params or d.type != VOID):
+			raise CompileError('line %d: main takes no parameters and returns void' % d.line)
+		for _, t in params:
+			if t.kind == 'sampler':
+				raise CompileError('line %d: sampler parameters are not supported' % d.line)
+		r = self.new_id()
+		self.name(r, d.name if d.name == 'main' else '%s(%s;' % (d.name, ';'.join(map(str, (t for _, t in params)))))
+		self.functions[d.name] = Function(r, d.type, params, body, d.name)
+
+	def function_body(self, f):
+		# parameters are pointers to variables of the caller
+		ptypes = [self.pointer(FUNCTION, t) for _, t in f.params]
+		ftype = self.unique(('function', self.tid(f.type)) + tuple(ptypes), 'TypeFunction', self.tid(f.type), ptypes)
+		header = [self.inst('Function', self.tid(f.type), f.id, 0, ftype)]
+		self.scopes.append({})
+		for (name, t), pt in zip(f.params, ptypes):
+			r = self.new_id()
+			header.append(self.inst('FunctionParameter', pt, r))
+			self.name(r, name)
+			self.declare(f.node, name, Symbol(Ref(t, r, [], FUNCTION, name=name)))
+		self.code, self.locals, self.current = [], [], f
+		first = self.new_id()
+		self.block = first
+		self.statement(f.node)
+		if self.block is not None:
+			if f.type != VOID:
+				raise CompileError('line %d: %s does not return a value at its end' % (f.node.line, f.name))
+			self.emit('Return')
+		self.scopes.pop()
+		# all variables are declared in the first block
+		self.function_code += header + [self.inst('Label', first)] + self.locals + self.code
+		self.function_code.append(self.inst('FunctionEnd'))
+
+	# statements
+
+	def statement(self, node):
+		kind = node.kind
+		if kind == 'block':
+			self.scopes.append({})
+			for s in node.args[0]:
+				self.statement(s)
+			self.scopes.pop()
+		elif kind == 'declare':
+			for d in node.args[0]:
+				self.local_declaration(d)
+		elif kind == 'expression':
+			self.expression(node.args[0])
+		elif kind == 'if':
+			self.if_statement(node)
+		elif kind == 'return':
+			self.return_statement(node)
+		elif kind == 'discard':
+			if self.stage != FRAGMENT:
+				raise self.error(node, 'discard is only allowed in fragment shaders')
+			self.emit('Kill')
+		else:
+			raise self.error(node, 'unsupported statement')
+
+	def local_declaration(self, d):
+		if set(d.qualifiers) - {'const'}:
+			raise CompileError('line %d: local variables take no qualifiers but const' % d.line)
+		if d.type.kind in ('sampler', 'void') or d.type.kind == 'array' and d.type.n is None:
+			raise CompileError('line %d: %s cannot be a local variable' % (d.line, d.type))
+		if 'const' in d.qualifiers:
+			if d.init is None:
+				raise CompileError('line %d: constants need a value' % d.line)
+			value = self.convert(d.init, self.expression(d.init), d.type)
+			if value.const is not None:
+				self.declare(d, d.name, Symbol(value=value))
+				return
+		init = None if d.init is None else self.convert(d.init, self.expression(d.init), d.type)
+		ref = self.local(d.type, d.name)
+		if 'const' in d.qualifiers:
+			ref.readonly = True
+		if init is not None:
+			self.emit('Store', ref.var, self.id_of(init))
+		self.declare(d, d.name, Symbol(ref))
+
+	def if_statement(self, node):
+		condition, then, otherwise = node.args
+		c = self.condition(condition)
+		then_label, merge = self.new_id(), self.new_id()
+		else_label = self.new_id() if otherwise else merge
+		self.emit('SelectionMerge', merge, 0)
+		self.emit('BranchConditional', self.id_of(c), then_label, else_label)
+		self.label(then_label)
+		self.scoped(then)
+		if self.block is not None:
+			self.emit('Branch', merge)
+		if otherwise:
+			self.label(else_label)
+			self.scoped(otherwise)
+			if self.block is not None:
+				self.emit('Branch', merge)
+		self.label(merge)
+
+	def scoped(self, node):
+		self.scopes.append({})
+		self.statement(node)
+		self.scopes.pop()
+
+	def return_statement(self, node):
+		value = node.args[0]
+		f = self.current
+		if value is None:
+			if f.type != VOID:
+				raise self.error(node, '%s must return a %s' % (f.name, f.type))
+			self.emit('Return')
+		else:
+			if f.type == VOID:
+				raise self.error(node, '%s returns nothing' % f.name)
+			self.emit('ReturnValue', self.id_of(self.convert(node, self.expression(value), f.type)))
+
+	def condition(self, node):
+		c = self.expression(node)
+		if c.type != BOOL:
+			raise self.error(node, 'conditions must be bool, not %s' % c.type)
+		return c
+
+	# expressions
+
+	def expression(self, node):
+		r = self.evaluate(node)
+		return self.load(node, r) if isinstance(r, Ref) else r
+
+	def load(self, node, ref):
+		if ref.type.kind == 'array' and ref.type.n is None:
+			raise self.error(node, 'runtime arrays can only be indexed')
+		if ref.chain:
+			p = self.new_id()
+			self.emit('AccessChain', self.pointer(ref.storage, ref.type, ref.packing), p, ref.var, ref.chain)
+		else:
+			p = ref.var
+		r = self.new_id()
+		self.emit('Load', self.tid(ref.type, ref.packing), r, p)
+		v = Value(ref.type, r)
+		if ref.packing and ref.type.kind in ('struct', 'array'):
+			v = self.unpack(v, ref.type, ref.packing)
+		return v
+
+	def unpack(self, v, t, packing):
+		# a struct read from a buffer has the offsets of the buffer, locals take its plain twin
+		if t.kind == 'struct':
+			parts = t.members
+		elif t.kind == 'array':
+			parts = [(None, t.elem)] * t.n
+		else:
+			return v
+		ids = []
+		for i, (_, m) in enumerate(parts):
+			r = self.new_id()
+			self.emit('CompositeExtract', self.tid(m, packing), r, v.id, i)
+			ids.append(self.unpack(Value(m, r), m, packing).id)
+		return self.op('CompositeConstruct', t, ids)
+
+	def store(self, node, ref, value):
+		if ref.readonly:
+			raise self.error(node, '%s cannot be written' % ref.name)
+		if ref.chain:
+			p = self.new_id()
+			self.emit('AccessChain', self.pointer(ref.storage, ref.type, ref.packing), p, ref.var, ref.chain)
+		else:
+			p = ref.var
+		self.emit('Store', p, self.id_of(value))
+
+	def evaluate(self, node):
+		kind = node.kind
+		if kind == 'number':
+			value, t = node.args
+			return Value(SCALAR[t], const=value)
+		if kind == 'name':
+			symbol = self.lookup(node, node.args[0])
+			return symbol.value if symbol.value is not None else symbol.ref
+		if kind == 'field':
+			return self.field(node)
+		if kind == 'index':
+			return self.index(node)
+		if kind == 'call':
+			return self.call(node)
+		if kind == 'unary':
+			return self.unary(node)
+		if kind == 'binary':
+			op, a, b = node.args
+			if op in ('&&', '||', '^^'):
+				return self.logical(node, op, self.condition(a), self.condition(b))
+			return self.binary(node, op, self.expression(a), self.expression(b))
+		if kind == 'assign':
+			return self.assign(node)
+		if kind == 'select':
+			return self.select(node)
+		raise self.error(node, 'unsupported expression')
+
+	def field(self, node):
+		base, name = node.args
+		b = self.evaluate(base)
+		t = b.type
+		if t.kind == 'struct':
+			for i, (n, m) in enumerate(t.members):
+				if n == name:
+					if isinstance(b, Ref):
+						return b.member(m, self.constant(INT, i))
+					return self.op('CompositeExtract', m, self.id_of(b), i)
+			raise self.error(node, '%s has no member %s' % (t, name))
+		if t.kind == 'vec' or t.scalar() and t.kind != 'bool':
+			return self.swizzle(node, self.load(node, b) if isinstance(b, Ref) else b, name)
+		raise self.error(node, '%s has no fields' % t)
+
+	def swizzle(self, node, v, name):
+		n = v.type.size()
+		for sets in ('xyzw', 'rgba', 'stpq'):
+			if all(c in sets for c in name):
+				picks = [sets.index(c) for c in name]
+				break
+		else:
+			raise self.error(node, 'bad swizzle .%s' % name)
+		if max(picks) >= n or len(picks) > 4:
+			raise self.error(node, '.%s is out of range for %s' % (name, v.type))
+		base = SCALAR[v.type.base()]
+		if v.type.scalar():
+			return self.construct(node, vec(base, len(picks)), [v] * len(picks))
+		if v.const is not None:
+			return Value(vec(base, len(picks)), const=v.const[picks[0]] if len(picks) == 1 else tuple(v.const[p] for p in picks))
+		if len(picks) == 1:
+			return self.op('CompositeExtract', base, v.id, picks[0])
+		return self.op('VectorShuffle', vec(base, len(picks)), v.id, v.id, picks)
+
+	def index(self, node):
+		base, index = node.args
+		b = self.evaluate(base)
+		i = self.expression(index)
+		if i.type not in (INT, UINT):
+			raise self.error(node, 'indexes must be int or uint')
+		t = b.type
+		if t.kind in ('array', 'mat', 'vec'):
+			elem = t.elem
+		else:
+			raise self.error(node, '%s cannot be indexed' % t)
+		if i.const is not None and t.n is not None and not 0 <= i.const < t.n:
+			raise self.error(node, 'index %d is out of range for %s' % (i.const, t))
+		if isinstance(b, Ref):
+			return b.member(elem, self.id_of(i))
+		if i.const is None:
+			raise self.error(node, 'values that are not variables can only be indexed by constants')
+		if b.const is not None:
+			return Value(elem, const=b.const[i.const])
+		return self.op('CompositeExtract', elem, b.id, i.const)
+
+	def assign(self, node):
+		op, lhs, rhs = node.args
+		ref = self.evaluate(lhs)
+		if not isinstance(ref, Ref):
+			raise self.error(node, 'only variables can be assigned')
+		value = self.expression(rhs)
+		if op != '=':
+			value = self.binary(node, op[:-1], self.load(node, ref), value)
+		value = self.convert(node, value, ref.type)
+		self.store(node, ref, value)
+		return value
+
+	def select(self, node):
+		condition, a, b = node.args
+		c = self.condition(condition)
+		if not a.effects() and not b.effects():
+			# both sides are evaluated up front, scalars pick one with OpSelect
+			va, vb = self.expression(a), self.expression(b)
+			t = self.common(node, va.type, vb.type)
+			va, vb = self.convert(node, va, t), self.convert(node, vb, t)
+			if c.const is not None:
+				return va if c.const else vb
+			if t.scalar():
+				return self.op('Select', t, self.id_of(c), self.id_of(va), self.id_of(vb))
+			sides = (lambda: va, lambda: vb)
+		else:
+			sides = (lambda: self.expression(a), lambda: self.expression(b))
+		# otherwise each side stores to a variable in a branch of its own
+		then_label, else_label, merge = self.new_id(), self.new_id(), self.new_id()
+		self.emit('SelectionMerge', merge, 0)
+		self.emit('BranchConditional', self.id_of(c), then_label, else_label)
+		results = []
+		for label, side in zip((then_label, else_label), sides):
+			self.label(label)
+			v = side()
+			results.append((v, self.code, len(self.code)))
+			self.emit('Branch', merge)
+		t = self.common(node, results[0][0].type, results[1][0].type)
+		result = self.local(t, 'temp')
+		# the stores go before the branches, now that the type is known
+		for v, code, at in reversed(results):
+			saved, saved_block = self.code, self.block
+			self.code, self.block = [], then_label
+			self.emit('Store', result.var, self.id_of(self.convert(node, v, t)))
+			code[at:at] = self.code
+			self.code, self.block = saved, saved_block
+		self.label(merge)
+		return self.load(node, result)
+
+	def common(self, node, a, b):
+		if a == b:
+			return a
+		for t in (a, b):
+			if a.size() == b.size() and self.converts(a, t) and self.converts(b, t):
+				return t
+		raise self.error(node, 'no common type for %s and %s' % (a, b))
+
+	@staticmethod
+	def converts(a, b):
+		# implicit conversions: int to uint, int and uint to float, component-wise
+		if a == b:
+			return True
+		if a.kind == 'vec' and b.kind == 'vec' and a.n == b.n:
+			a, b = a.elem, b.elem
+		return (a.kind, b.kind) in (('int', 'uint'), ('int', 'float'), ('uint', 'float'))
+
+	def convert(self, node, v, t, explicit=False):
+		if v.type == t:
+			return v
+		if not explicit and not self.converts(v.type, t):
+			raise self.error(node, 'cannot convert %s to %s' % (v.type, t))
+		if v.type.size() != t.size() or v.type.base() is None or t.base() is None or t.kind == 'mat':
+			raise self.error(node, 'cannot convert %s to %s' % (v.type, t))
+		src, dst = v.type.base(), t.base()
+		if v.const is not None:
+			def one(x):
+				if dst == 'float':
+					return f32(float(x))
+				if dst == 'bool':
+					return bool(x)
+				x = int(x)	# float to int truncates toward zero
+				if dst == 'int':
+					x &= 0xffffffff
+					return x - (1 << 32) if x >= 1 << 31 else x
+				return x & 0xffffffff
+			return Value(t, const=one(v.const) if t.scalar() else tuple(one(x) for x in v.const))
+		if src == 'bool' or dst == 'bool':
+			zero = Value(vec(SCALAR[src], t.size()), const=self.zeros(src, t.size()))
+			if dst == 'bool':
+				return self.compare(node, '!=', v, zero)
+			one = Value(t, const=1.0 if dst == 'float' else 1) if t.scalar() else Value(t, const=(1.0 if dst == 'float' else 1,) * t.size())
+			zero_t = Value(t, const=self.zeros(dst, t.size()))
+			return self.op('Select', t, self.id_of(v), self.id_of(one), self.id_of(zero_t))
+		op = {('int', 'float'): 'ConvertSToF', ('uint', 'float'): 'ConvertUToF', ('float', 'int'): 'ConvertFToS',
+			('float', 'uint'): 'ConvertFToU', ('int', 'uint'): 'Bitcast', ('uint', 'int'): 'Bitcast'}[(src, dst)]
+		return self.op(op, t, self.id_of(v))
+
+	@staticmethod
+	def zeros(kind, n):
+		z = {'float': 0.0, 'bool': False}.get(kind, 0)
+		return z if n == 1 else (z,) * n
+
+	def unary(self, node):
+		op, e = node.args
+		v = self.expression(e)
+		base = v.type.base()
+		if op == '+' and base in ('int', 'uint', 'float'):
+			return v
+		if op == '-' and base in ('int', 'uint', 'float'):
+			if v.const is not None and v.type.scalar():
+				return self.convert(node, Value(INT if base != 'float' else FLOAT, const=-v.const), v.type, True)
+			return self.op('FNegate' if base == 'float' else 'SNegate', v.type, self.id_of(v))
+		if op == '!' and v.type == BOOL:
+			if v.const is not None:
+				return Value(BOOL, const=not v.const)
+			return self.op('LogicalNot', BOOL, self.id_of(v))
+		if op == '~' and base in ('int', 'uint'):
+			if v.const is not None and v.type.scalar():
+				return self.convert(node, Value(UINT, const=~v.const & 0xffffffff), v.type, True)
+			return self.op('Not', v.type, self.id_of(v))
+		raise self.error(node, 'operator %s does not apply to %s' % (op, v.type))
+
+	def logical(self, node, op, a, b):
+		# both sides are evaluated, which only matters to sides with effects
+		if node.args[2].effects():
+			raise self.error(node, 'the right side of %s cannot have effects' % op)
+		if a.const is not None and b.const is not None:
+			return Value(BOOL, const={'&&': a.const and b.const, '||': a.const or b.const, '^^': a.const != b.const}[op])
+		name = {'&&': 'LogicalAnd', '||': 'LogicalOr', '^^': 'LogicalNotEqual'}[op]
+		return self.op(name, BOOL, self.id_of(a), self.id_of(b))
+
+	def binary(self, node, op, a, b):
+		if op in ('==', '!=', '<', '>', '<=', '>='):
+			return self.compare(node, op, a, b)
+		ta, tb = a.type, b.type
+		if op == '*' and ('mat' in (ta.kind, tb.kind)):
+			return self.matrix_product(node, a, b)
+		if ta.base() in (None, 'bool') or tb.base() in (None, 'bool') or 'mat' in (ta.kind, tb.kind):
+			raise self.error(node, 'operator %s does not apply to %s and %s' % (op, ta, tb))
+		if op in ('<<', '>>'):
+			if ta.base() == 'float' or tb.base() == 'float' or tb.size() not in (1, ta.size()):
+				raise self.error(node, 'operator %s does not apply to %s and %s' % (op, ta, tb))
+			if tb.size() != ta.size():
+				b = self.splat(node, b, vec(tb, ta.size()))
+			if a.const is not None and b.const is not None and ta.scalar():
+				r = a.const << b.const if op == '<<' else a.const >> b.const
+				return self.convert(node, Value(INT, const=r), ta, True)
+			name = 'ShiftLeftLogical' if op == '<<' else 'ShiftRightArithmetic' if ta.base() == 'int' else 'ShiftRightLogical'
+			return self.op(name, ta, self.id_of(a), self.id_of(b))
+		base = self.common(node, SCALAR[ta.base()], SCALAR[tb.base()])
+		if ta.size() != tb.size() and 1 not in (ta.size(), tb.size()):
+			raise self.error(node, 'operator %s does not apply to %s and %s' % (op, ta, tb))
+		a = self.convert(node, a, vec(base, ta.size()))
+		b = self.convert(node, b, vec(base, tb.size()))
+		kind = base.kind
+		if op in ('%', '&', '|', '^') and kind == 'float':
+			raise self.error(node, 'operator %s needs integers' % op)
+		if a.const is not None and b.const is not None and a.type.scalar() and b.type.scalar():
+			return self.fold(node, op, a, b)
+		if op == '*' and kind == 'float' and a.type.size() != b.type.size():
+			v, s = (a, b) if b.type.scalar() else (b, a)
+			return self.op('VectorTimesScalar', v.type, self.id_of(v), self.id_of(s))
+		t = a.type if a.type.size() >= b.type.size() else b.type
+		a, b = self.splat(node, a, t), self.splat(node, b, t)
+		name = {
+			'+': {'float': 'FAdd'}, '-': {'float': 'FSub'}, '*': {'float': 'FMul'},
+			'/': {'float': 'FDiv', 'int': 'SDiv', 'uint': 'UDiv'}, '%': {'int': 'SMod', 'uint': 'UMod'},
+			'&': {}, '|': {}, '^': {},
+		}[op].get(kind, {'+': 'IAdd', '-': 'ISub', '*': 'IMul', '&': 'BitwiseAnd', '|': 'BitwiseOr', '^': 'BitwiseXor'}.get(op))
+		return self.op(name, t, self.id_of(a), self.id_of(b))
+
+	def fold(self, node, op, a, b):
+		x, y, kind = a.const, b.const, a.type.kind
+		if kind == 'float':
+			r = f32({'+': x + y, '-': x - y, '*': x * y}[op] if op != '/' else x / y if y else float('inf') if x > 0 else float('-inf') if x < 0 else float('nan'))
+			return Value(FLOAT, const=r)
+		if op in ('/', '%') and y == 0:
+			raise self.error(node, 'division by zero')
+		if kind == 'int':
+			q = abs(x) // abs(y) * (1 if (x < 0) == (y < 0) else -1) if op in ('/', '%') else 0
+			r = {'+': x + y, '-': x - y, '*': x * y, '/': q, '%': x - q * y if op == '%' else 0,
+				'&': x & y, '|': x | y, '^': x ^ y}[op]
+		else:
+			r = {'+': x + y, '-': x - y, '*': x * y, '/': x // y if y else 0, '%': x % y if y else 0,
+				'&': x & y, '|': x | y, '^': x ^ y}[op]
+		return self.convert(node, Value(INT, const=r), a.type, True)
+
+	def splat(self, node, v, t):
+		if v.type == t:
+			return v
+		if v.const is not None:
+			return Value(t, const=(v.const,) * t.size())
+		return self.op('CompositeConstruct', t, [self.id_of(v)] * t.size())
+
+	def matrix_product(self, node, a, b):
+		ta, tb = a.type, b.type
+		a = self.convert(node, a, FLOAT) if ta.scalar() else a
+		b = self.convert(node, b, FLOAT) if tb.scalar() else b
+		if ta.kind == 'mat' and tb.kind == 'mat' and ta.n == tb.elem.n:
+			return self.op('MatrixTimesMatrix', mat(tb.n, ta.elem.n), self.id_of(a), self.id_of(b))
+		if ta.kind == 'mat' and tb == vec(FLOAT, ta.n):
+			return self.op('MatrixTimesVector', ta.elem, self.id_of(a), self.id_of(b))
+		if tb.kind == 'mat' and ta == tb.elem:
+			return self.op('VectorTimesMatrix', vec(FLOAT, tb.n), self.id_of(a), self.id_of(b))
+		if ta.kind == 'mat' and b.type == FLOAT:
+			return self.op('MatrixTimesScalar', ta, self.id_of(a), self.id_of(b))
+		if tb.kind == 'mat' and a.type == FLOAT:
+			return self.op('MatrixTimesScalar', tb, self.id_of(b), self.id_of(a))
+		raise self.error(node, 'cannot multiply %s by %s' % (ta, tb))
+
+	def compare(self, node, op, a, b):
+		if not a.type.scalar() or not b.type.scalar():
+			raise self.error(node, 'only scalars can be compared')
+		t = self.common(node, a.type, b.type)
+		a, b = self.convert(node, a, t), self.convert(node, b, t)
+		if t == BOOL and op not in ('==', '!='):
+			raise self.error(node, 'bools can only be compared for equality')
+		if a.const is not None and b.const is not None:
+			x, y = a.const, b.const
+			return Value(BOOL, const={'==': x == y, '!=': x != y, '<': x < y, '>': x > y, '<=': x <= y, '>=': x >= y}[op])
+		names = {
+			'float': dict(zip(('==', '!=', '<', '>', '<=', '>='), ('FOrdEqual', 'FOrdNotEqual', 'FOrdLessThan',
+				'FOrdGreaterThan', 'FOrdLessThanEqual', 'FOrdGreaterThanEqual'))),
+			'int': dict(zip(('==', '!=', '<', '>', '<=', '>='), ('IEqual', 'INotEqual', 'SLessThan',
+				'SGreaterThan', 'SLessThanEqual', 'SGreaterThanEqual'))),
+			'uint': dict(zip(('==', '!=', '<', '>', '<=', '>='), ('IEqual', 'INotEqual', 'ULessThan',
+				'UGreaterThan', 'ULessThanEqual', 'UGreaterThanEqual'))),
+			'bool': {'==': 'LogicalEqual', '!=': 'LogicalNotEqual'},
+		}
+		return self.op(names[t.kind][op], BOOL, self.id_of(a), self.id_of(b))
+
+	# calls
+
+	def call(self, node):
+		name, args, user = node.args
+		if user:
+			return self.user_call(node, self.functions.get(name), args)
+		if name in self.types:
+			return self.construct(node, self.types[name], [self.expression(a) for a in args])
+		if name == 'texture':
+			return self.texture(node, args)
+		values = [self.expression(a) for a in args]
+		return self.builtin_function(node, name, values)
+
+	def user_call(self, node, f, args):
+		if f is None:
+			raise self.error(node, 'functions must be defined before they are called')
+		if len(args) != len(f.params):
+			raise self.error(node, '%s takes %d arguments' % (f.name, len(f.params)))
+		pointers = []
+		for a, (pname, t) in zip(args, f.params):
+			v = self.convert(a, self.expression(a), t)
+			param = self.local(t, 'param')
+			self.emit('Store', param.var, self.id_of(v))
+			pointers.append(param.var)
+		return self.op('FunctionCall', f.type, f.id, pointers)
+
+	def construct(self, node, t, values):
+		if not values:
+			raise self.error(node, '%s needs arguments' % t)
+		for v in values:
+			if v.type.base() is None:
+				raise self.error(node, '%s cannot be built from %s' % (t, v.type))
+		if t.scalar():
+			v = values[0]
+			if not v.type.scalar():
+				v = self.component(node, v, 0)
+			return self.convert(node, v, t, True)
+		if t.kind == 'vec':
+			if len(values) == 1 and values[0].type.scalar():
+				return self.splat(node, self.convert(node, values[0], t.elem, True), t)
+			parts = []
+			for v in values:
+				if len(parts) >= t.n:
+					raise self.error(node, 'too many arguments for %s' % t)
+				if v.type.kind == 'mat':
+					raise self.error(node, '%s cannot be built from a matrix' % t)
+				for i in range(min(v.type.size(), t.n - len(parts))):
+					parts.append(self.convert(node, self.component(node, v, i), t.elem, True))
+			if len(parts) < t.n:
+				raise self.error(node, 'not enough arguments for %s' % t)
+			if all(p.const is not None for p in parts):
+				return Value(t, const=tuple(p.const for p in parts))
+			return self.op('CompositeConstruct', t, [self.id_of(p) for p in parts])
+		if t.kind == 'mat':
+			if len(values) == 1 and values[0].type.kind == 'mat':
+				# the top left corner of a bigger matrix, or a smaller one inside the identity
+				m = values[0]
+				rows = m.type.elem.n
+				columns = []
+				for c in range(t.n):
+					if c >= m.type.n:
+						columns.append(self.id_of(Value(t.elem, const=tuple(1.0 if r == c else 0.0 for r in range(t.elem.n)))))
+						continue
+					column = self.op('CompositeExtract', m.type.elem, m.id, c)
+					if t.elem.n < rows:
+						column = self.op('VectorShuffle', t.elem, column.id, column.id, list(range(t.elem.n)))
+					elif t.elem.n > rows:
+						parts = [self.component(node, column, r) for r in range(rows)]
+						parts += [Value(FLOAT, const=1.0 if r == c else 0.0) for r in range(rows, t.elem.n)]
+						column = self.op('CompositeConstruct', t.elem, [self.id_of(x) for x in parts])
+					columns.append(column.id)
+				return self.op('CompositeConstruct', t, columns)
+			if len(values) == t.n and all(v.type == t.elem for v in values):
+				return self.op('CompositeConstruct', t, [self.id_of(v) for v in values])
+			raise self.error(node, '%s can only be built from a matrix or its columns' % t)
+		raise self.error(node, '%s has no constructor' % t)
+
+	def component(self, node, v, i):
+		if v.type.scalar():
+			return v
+		if v.const is not None:
+			return Value(v.type.elem, const=v.const[i])
+		return self.op('CompositeExtract', v.type.elem, v.id, i)
+
+	def texture(self, node, args):
+		if len(args) != 2:
+			raise self.error(node, 'texture takes a sampler and coordinates')
+		sampler = self.evaluate(args[0])
+		if not isinstance(sampler, Ref) or sampler.type.kind != 'sampler':
+			raise self.error(node, 'texture needs a sampler')
+		dim, arrayed = sampler.type.n
+		size = 3 if dim == 3 else 2 + arrayed
+		coordinates = self.convert(node, self.expression(args[1]), vec(FLOAT, size))
+		image = self.load(node, sampler)
+		t = vec(FLOAT, 4)
+		if self.stage == FRAGMENT:
+			return self.op('ImageSampleImplicitLod', t, image.id, self.id_of(coordinates))
+		# outside of fragment shaders there are no derivatives, the first level is read
+		return self.op('ImageSampleExplicitLod', t, image.id, self.id_of(coordinates), 2, self.id_of(Value(FLOAT, const=0.0)))
+
+	def builtin_function(self, node, name, values):
+		n = len(values)
+
+		def floats(count, scalars=()):
+			# genType arguments, the ones at positions in scalars may also be a single float
+			if n != count:
+				raise self.error(node, '%s takes %d arguments' % (name, count))
+			size = max(v.type.size() for v in values)
+			out = []
+			for i, v in enumerate(values):
+				if v.type.kind not in ('int', 'uint', 'float', 'vec') or v.type.base() == 'bool':
+					raise self.error(node, '%s does not take %s' % (name, v.type))
+				if v.type.size() == 1 and size > 1 and i not in scalars:
+					raise self.error(node, '%s needs arguments of the same size' % name)
+				if v.type.size() not in (1, size):
+					raise self.error(node, '%s needs arguments of the same size' % name)
+				out.append(self.splat(node, self.convert(node, v, vec(FLOAT, v.type.size())), vec(FLOAT, size)))
+			return out, vec(FLOAT, size)
+
+		def integers():
+			kinds = {v.type.base() for v in values}
+			return len(kinds) == 1 and kinds <= {'int', 'uint'} and kinds.pop()
+
+		one = {'radians': 'Radians', 'degrees': 'Degrees', 'sin': 'Sin', 'cos': 'Cos', 'tan': 'Tan',
+			'asin': 'Asin', 'acos': 'Acos', 'exp': 'Exp', 'log': 'Log', 'exp2': 'Exp2', 'log2': 'Log2',
+			'sqrt': 'Sqrt', 'inversesqrt': 'InverseSqrt', 'floor': 'Floor', 'ceil': 'Ceil', 'fract': 'Fract',
+			'trunc': 'Trunc', 'round': 'Round', 'normalize': 'Normalize'}
+		if name in one:
+			args, t = floats(1)
+			return self.ext(t, one[name], *args)
+		if name in ('abs', 'sign') and n == 1 and integers() == 'int':
+			return self.ext(values[0].type, 'SAbs' if name == 'abs' else 'SSign', values[0])
+		if name in ('abs', 'sign'):
+			args, t = floats(1)
+			return self.ext(t, 'FAbs' if name == 'abs' else 'FSign', *args)
+		if name == 'atan':
+			args, t = floats(n)
+			return self.ext(t, 'Atan' if n == 1 else 'Atan2', *args)
+		if name in ('pow', 'reflect', 'step'):
+			args, t = floats(2, (0,) if name == 'step' else ())
+			return self.ext(t, {'pow': 'Pow', 'reflect': 'Reflect', 'step': 'Step'}[name], *args)
+		if name in ('min', 'max'):
+			kind = integers()
+			if kind and n == 2:
+				size = max(v.type.size() for v in values)
+				t = vec(SCALAR[kind], size)
+				args = [self.splat(node, v, t) for v in values]
+				return self.ext(t, ('S' if kind == 'int' else 'U') + name.capitalize(), *args)
+			args, t = floats(2, (1,))
+			return self.ext(t, 'F' + name.capitalize(), *args)
+		if name == 'clamp':
+			kind = integers()
+			if kind and n == 3:
+				t = vec(SCALAR[kind], values[0].type.size())
+				args = [self.splat(node, v, t) for v in values]
+				return self.ext(t, 'SClamp' if kind == 'int' else 'UClamp', *args)
+			args, t = floats(3, (1, 2))
+			return self.ext(t, 'FClamp', *args)
+		if name == 'mix':
+			args, t = floats(3, (2,))
+			return self.ext(t, 'FMix', *args)
+		if name == 'smoothstep':
+			args, t = floats(3, (0, 1))
+			return self.ext(t, 'SmoothStep', *args)
+		if name in ('length', 'distance', 'dot', 'cross'):
+			count = 1 if name == 'length' else 2
+			args, t = floats(count)
+			if name == 'cross':
+				if t != vec(FLOAT, 3):
+					raise self.error(node, 'cross takes vec3 arguments')
+				return self.ext(t, 'Cross', *args)
+			if name == 'dot':
+				if t.scalar():
+					return self.binary(node, '*', args[0], args[1])
+				return self.op('Dot', FLOAT, self.id_of(args[0]), self.id_of(args[1]))
+			return self.ext(FLOAT, 'Length' if name == 'length' else 'Distance', *args)
+		if name in ('transpose', 'inverse', 'determinant'):
+			if n != 1 or values[0].type.kind != 'mat':
+				raise self.error(node, '%s takes a matrix' % name)
+			m = values[0]
+			if name == 'transpose':
+				return self.op('Transpose', mat(m.type.elem.n, m.type.n), self.id_of(m))
+			if m.type.n != m.type.elem.n:
+				raise self.error(node, '%s takes a square matrix' % name)
+			return self.ext(m.type if name == 'inverse' else FLOAT, 'MatrixInverse' if name == 'inverse' else 'Determinant', m)
+		raise self.error(node, 'unknown function %s' % name)
+
+	# module
+
+	def module(self):
+		main = self.functions['main'].id
+		head = [self.inst('Capability', 1)]
+		head += [self.inst('ExtInstImport', self.glsl, words('GLSL.std.450'))]
+		head += [self.inst('MemoryModel', 0, 1)]
+		head += [self.inst('EntryPoint', self.stage, main, words('main'), self.interface)]
+		if self.stage == FRAGMENT:
+			head += [self.inst('ExecutionMode', main, 7)]	# OriginUpperLeft
+		head += [self.inst('Source', 2, 450)]				# GLSL 450
+		head += [self.inst('SourceExtension', words(e)) for e in self.extensions]
+		body = head + self.names + self.annotations + self.globals + self.function_code
+		ws = [0x07230203, 0x00010000, GENERATOR, self.bound, 0]
+		for i in body:
+			ws.extend(i)
+		return struct.pack('<%dI' % len(ws), *ws)
+
+
+def compile_source(src, stage):
+	extensions, tokens = tokenize(src)
+	parser = Parser(tokens)
+	declarations = parser.unit()
+	compiler = Compiler(stage, extensions, parser.types)
+	return compiler.compile(declarations)
+
+
+def main(paths):
+	if not paths:
+		print('usage: compile.py <shader.vert|shader.frag>...', file=sys.stderr)
+		return 2
+	failed = False
+	for path in paths:
+		base, extension = os.path.splitext(path)
+		stage = {'.vert': VERTEX, '.frag': FRAGMENT}.get(extension)
+		if stage is None:
+			print('%s: shaders end in .vert or .frag' % path, file=sys.stderr)
+			failed = True
+			continue
+		try:
+			with open(path) as f:
+				spirv = compile_source(f.read(), stage)
+		except CompileError as e:
+			print('%s: %s' % (path, e), file=sys.stderr)
+			failed = True
+			continue
+		# Tile.vert becomes TileVert.spv
+		with open(base + extension[1:].capitalize() + '.spv', 'wb') as f:
+			f.write(spirv)
+	return 1 if failed else 0
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,178 @@
+// HEADLESS GAME SIMULATOR
+
+// Plays many games of Mahjong without opening a window and reports throughput, win rate and
+// how deep the lost games got. Usage:
+//   simulator [games] [random|greedy] [solvable|shuffle] [threads] [seed] [replay folder]
+//   simulator replay file.mjr [more.mjr ...]
+// Every game gets its own seed derived from the main one, so a run gives the same results whatever
+// the number of threads. When a folder is given, the replay of every game is saved in it.
+// The second form plays recorded games again and checks they are still legal.
+
+#include "MahjongReplay.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <iomanip>
+#include <string>
+
+using namespace std;
+
+enum PlayPolicy {
+	POLICY_RANDOM,		// Any legal pair, chosen uniformly
+	POLICY_GREEDY		// The legal pair leaving the most legal pairs on the board
+};
+
+// Statistics collected by one worker
+struct alignas(64) SimulationStats {
+	long long games = 0;
+	long long wins = 0;
+	vector<long long> deadEndDepths;	// deadEndDepths[d] counts the lost games stuck after removing d pairs
+};
+
+// plays a whole game, returns the number of pairs removed
+int playGame(MahjongGame& game, PlayPolicy policy, mt19937_64& rng) {
+	int depth = 0;
+	while (!game.isWon() && !game.isGameOver()) {
+		vector<pair<int, int>> pairs = game.getLegalPairs();
+		pair<int, int> chosen;
+		if (policy == POLICY_GREEDY) {
+			// try every pair and keep the one leaving most options, ties broken at random
+			int bestScore = -1;
+			int ties = 0;
+			for (pair<int, int>& candidate : pairs) {
+				game.removeTiles(candidate.first, candidate.second);
+				int score = game.isWon() ? INT_MAX : (int)game.getLegalPairs().size();
+				game.undo();
+				if (score > bestScore) {
+					bestScore = score;
+					chosen = candidate;
+					ties = 1;
+				}
+				else if (score == bestScore && rng() % ++ties == 0) {
+					chosen = candidate;
+				}
+			}
+		}
+		else {
+			chosen = pairs[rng() % pairs.size()];
+		}
+		game.removeTiles(chosen.first, chosen.second);
+		depth++;
+	}
+	return depth;
+}
+
+// seed of the i-th game of a run, consecutive games get unrelated seeds
+uint64_t gameSeed(uint64_t seed, long long gameIdx) {
+	uint64_t z = seed + 0x9e3779b97f4a7c15ULL * (gameIdx + 1);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// plays recorded games again, reports the moves per second and any replay that does not hold anymore
+int replayGames(int fileCount, char* files[], const string& structurePath) {
+	shared_ptr<const MahjongLayout> layout = MahjongLayout::open(structurePath);
+	vector<MahjongReplay> replays;
+	for (int i = 0; i < fileCount; i++) replays.push_back(MahjongReplay::load(files[i]));
+	MahjongGame game = MahjongGame(layout);
+	long long moves = 0;
+	int broken = 0;
+	auto startTime = chrono::steady_clock::now();
+	for (int i = 0; i < (int)replays.size(); i++) {
+		int played = replays[i].play(game);
+		moves += played;
+		if (played != replays[i].stepCount()) {
+			cout << files[i] << ": step " << played + 1 << " (move or reshuffle) is not legal anymore\n";
+			broken++;
+		}
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	cout << fixed << setprecision(2);
+	cout << "Replays:    " << replays.size() << " (" << broken << " broken)\n";
+	cout << "Throughput: " << replays.size() / seconds << " replays/s, " << moves / seconds << " moves/s\n";
+	return broken == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[]) {
+	string structurePath = "./structure.json";
+	if (argc > 1 && string(argv[1]) == "replay") {
+		try {
+			return replayGames(argc - 2, argv + 2, structurePath);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	long long games = argc > 1 ? stoll(argv[1]) : 10000;
+	PlayPolicy policy = (argc > 2 && string(argv[2]) == "greedy") ? POLICY_GREEDY : POLICY_RANDOM;
+	DealMode dealMode = (argc > 3 && string(argv[3]) == "solvable") ? DEAL_SOLVABLE : DEAL_RANDOM;
+	int threads = argc > 4 ? stoi(argv[4]) : 0;
+	uint64_t seed = argc > 5 ? stoull(argv[5]) : MahjongGame::randomSeed();
+	string replayFolder = argc > 6 ? argv[6] : "";
+
+	try {
+		// all the games share the same layout, each worker deals again its own game
+		shared_ptr<const MahjongLayout> layout = MahjongLayout::open(structurePath);
+		ThreadPool pool(threads);
+		vector<SimulationStats> stats(pool.size());
+		atomic<long long> nextGame(0);
+		auto startTime = chrono::steady_clock::now();
+		pool.run([&](int workerIdx) {
+			SimulationStats& workerStats = stats[workerIdx];
+			MahjongGame game = MahjongGame(layout, dealMode, seed);
+			mt19937_64 rng;
+			long long gameIdx;
+			while ((gameIdx = nextGame.fetch_add(1)) < games) {
+				// the deal and the moves of a game only depend on its own seed
+				uint64_t dealSeed = gameSeed(seed, gameIdx);
+				game.newGame(dealMode, dealSeed);
+				rng.seed(~dealSeed);
+				int depth = playGame(game, policy, rng);
+				if (!replayFolder.empty()) {
+					MahjongReplay::record(game).save(replayFolder + "/" + to_string(gameIdx) + ".mjr");
+				}
+				workerStats.games++;
+				if (game.isWon()) {
+					workerStats.wins++;
+				}
+				else {
+					if ((int)workerStats.deadEndDepths.size() <= depth) workerStats.deadEndDepths.resize(depth + 1);
+					workerStats.deadEndDepths[depth]++;
+				}
+			}
+		});
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+		// merge worker statistics
+		SimulationStats total;
+		for (SimulationStats& workerStats : stats) {
+			total.games += workerStats.games;
+			total.wins += workerStats.wins;
+			if (total.deadEndDepths.size() < workerStats.deadEndDepths.size()) total.deadEndDepths.resize(workerStats.deadEndDepths.size());
+			for (int d = 0; d < (int)workerStats.deadEndDepths.size(); d++) total.deadEndDepths[d] += workerStats.deadEndDepths[d];
+		}
+
+		cout << fixed << setprecision(2);
+		cout << "Games:      " << total.games << " (" << (policy == POLICY_GREEDY ? "greedy" : "random") << " play, "
+			<< (dealMode == DEAL_SOLVABLE ? "solvable" : "shuffled") << " deals, " << pool.size() << " threads, seed " << seed << ")\n";
+		cout << "Throughput: " << total.games / seconds << " games/s\n";
+		cout << "Win rate:   " << 100.0 * total.wins / max(1LL, total.games) << "%\n";
+		cout << "Dead ends (pairs removed before getting stuck):\n";
+		long long lost = total.games - total.wins;
+		for (int d = 0; d < (int)total.deadEndDepths.size(); d++) {
+			if (total.deadEndDepths[d] == 0) continue;
+			cout << setw(4) << d << ": " << setw(8) << total.deadEndDepths[d] << "  "
+				<< setw(6) << 100.0 * total.deadEndDepths[d] / lost << "%\n";
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
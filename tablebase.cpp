@@ -0,0 +1,54 @@
+// ENDGAME TABLEBASE BUILDER
+
+// Decides every endgame of some deals and writes one table per deal, which the game loads when the
+// deal is played. Usage:
+//   tablebase [solvable|shuffle] maxTiles seed [more seeds ...]
+// Tables are written as endgame_<seed>.mjt in the current folder. 8 tiles take a few seconds and
+// less than a megabyte per deal, every two more tiles cost about fifteen times as much: 10 tiles,
+// about two minutes per deal, is the practical limit. A table only serves the deal it was built for.
+
+#include "EndgameTable.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	int first = (argc > 1 && (string(argv[1]) == "solvable" || string(argv[1]) == "shuffle")) ? 2 : 1;
+	if (argc < first + 2) {
+		cerr << "Usage: tablebase [solvable|shuffle] maxTiles seed [more seeds ...]" << endl;
+		cerr << "maxTiles up to 10 in practice, 10 tiles take about two minutes per deal" << endl;
+		return EXIT_FAILURE;
+	}
+	DealMode dealMode = (first == 2 && string(argv[1]) == "shuffle") ? DEAL_RANDOM : DEAL_SOLVABLE;
+	int maxTiles = stoi(argv[first]);
+	string structurePath = "./structure.json";
+	int failures = 0;
+	try {
+		shared_ptr<const MahjongLayout> layout = MahjongLayout::open(structurePath);
+		MahjongGame game = MahjongGame(layout);
+		for (int i = first + 1; i < argc; i++) {
+			uint64_t seed = stoull(argv[i]);
+			string path = "./endgame_" + to_string(seed) + ".mjt";
+			try {
+				auto startTime = chrono::steady_clock::now();
+				game.newGame(dealMode, seed);
+				EndgameTable::compile(MahjongBitboard(game), maxTiles, path);
+				double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+				shared_ptr<const EndgameTable> table = EndgameTable::open(path);
+				cout << fixed << setprecision(2) << path << ": " << table->positionCount() << " positions, "
+					<< table->winCount() << " won, " << seconds << " s" << endl;
+			}
+			catch (const std::exception& e) {
+				cerr << path << ": " << e.what() << endl;
+				failures++;
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}